@@ -3,74 +3,220 @@
 #include "freertos/task.h"  // Provides access to task functionalities in FreeRTOS.
 #include "driver/gpio.h"  // GPIO driver for handling general-purpose input/output pins.
 #include "driver/adc.h"  // ADC driver for handling analog-to-digital conversion.
-#include "driver/ledc.h"  // LEDC driver for handling PWM operations.
 #include "esp_adc_cal.h"  // Provides functionalities for ADC calibration.
 #include "esp_log.h"  // Logging library to output debugging information.
+#include "esp_timer.h"  // High-resolution timer used for throughput statistics.
+#include "esp_cpu.h"  // CPU cycle counter used to measure processing time per block.
+#include "adc_sampler.h"  // Continuous DMA sampling engine shared between the examples.
+#include "adc_scan.h"  // Multi-channel scan scheduler with per-channel buffers.
+#include "adc_calibration.h"  // Raw-to-millivolt lookup table and fixed-point filter chain.
+#include "servo_duty_map.h"  // Compile-time ADC-to-duty table, slew limiter and write suppression.
+#include "servo_output_engine.h"  // Owns the LEDC timers and channels and applies whole frames of servo targets.
+#include "trace_ring.h"  // Binary per-core trace records, drained in bulk by a low-priority task.
 
-// Constants defining the maximum values for ADC and PWM resolutions and pulse calculations
-#define MAX_ADC_VALUE 4095  // Maximum value for 12-bit ADC resolution.
-#define MAX_PWM_VALUE 4095  // Assumes the highest resolution for your PWM configuration.
-#define PWM_1_MS_VALUE (MAX_PWM_VALUE / 20)  // Defines a 1 ms pulse width based on PWM configuration.
-#define PWM_2_MS_VALUE ((MAX_PWM_VALUE / 10) + 100)  // Defines a 2 ms pulse width.
+// Pulse endpoints, PWM frequency and resolution live in servo_duty_map.h, which generates the mapping table from them.
+#define SERVO_DEADBAND 8  // Ignore filtered readings that move less than this many raw codes.
+#define SERVO_MAX_STEP 8  // Largest duty change per block, limits how fast the servo can slew.
 
 #define POTENTIOMETER_ADC_CHANNEL ADC1_CHANNEL_6  // Assigns the potentiometer to ADC channel 6.
 #define SERVO_PIN GPIO_NUM_32  // Defines the GPIO pin connected to the servo.
+#define NUM_SERVOS 1  // Servos driven by the output engine, up to SERVO_ENGINE_MAX_CHANNELS.
+
+#define ADC_SAMPLE_RATE_HZ 20000  // Total conversion rate across all scanned channels (the ESP32 DMA minimum is 20 kHz).
+#define STATS_INTERVAL_US 1000000  // How often throughput statistics are logged.
+#define TRACE_BLOCK_EVERY 4  // Trace every 4th of the ~78 blocks/s, leaving console room for the servo records.
+#define TRACE_DRAIN_PERIOD_MS 100  // How often the trace task prints the rings (well before 256 records pile up).
+
+#define ACQUISITION_CORE 0  // Core that drains the DMA and sorts samples per channel.
+#define PROCESSING_CORE 1  // Core that filters the blocks and drives the servo.
+
+// Channels to scan, each with its own attenuation and rate divider. The first entry drives the servo.
+static const adc_scan_channel_t scan_channels[] = {
+    { .channel = POTENTIOMETER_ADC_CHANNEL, .atten = ADC_ATTEN_DB_11, .rate_div = 1 },
+    // { .channel = ADC1_CHANNEL_7, .atten = ADC_ATTEN_DB_11, .rate_div = 4 },  // Example: a slow sensor on GPIO 35.
+};
+#define NUM_SCAN_CHANNELS (sizeof(scan_channels) / sizeof(scan_channels[0]))
+#define POTENTIOMETER_SLOT 0  // Index of the potentiometer in scan_channels.
 
 static const char* TAG = "app_main";  // Tag used for logging messages.
-static esp_adc_cal_characteristics_t *adc_chars;  // Pointer to store ADC characteristics.
+static adc_cal_table_t adc_cal;  // Raw-to-millivolt table, built once at startup.
+static adc_filter_chain_t channel_filters[NUM_SCAN_CHANNELS];  // One filter chain per scanned channel.
+static int32_t channel_values[NUM_SCAN_CHANNELS];  // Latest filtered reading per channel (raw 12-bit code).
+static servo_stage_t servo_stage;  // Deadband, slew limit and duplicate-write suppression for the servo.
+static const gpio_num_t servo_pins[NUM_SERVOS] = { SERVO_PIN };  // One GPIO per engine channel.
+static servo_engine_ledc_t servo_ledc;  // LEDC backend state for the output engine.
+static servo_engine_t servo_engine;  // Output engine that applies frames of servo duties.
 
-void app_main(void) {
-    // Set ADC width to 12 bits and configure the attenuation for channel 6.
-    adc1_config_width(ADC_WIDTH_BIT_12);
-    adc1_config_channel_atten(POTENTIOMETER_ADC_CHANNEL, ADC_ATTEN_DB_11);
-    
-    // Allocate memory and initialize ADC calibration data.
-    adc_chars = calloc(1, sizeof(esp_adc_cal_characteristics_t));
-    esp_adc_cal_characterize(ADC_UNIT_1, ADC_ATTEN_DB_11, ADC_WIDTH_BIT_12, 1100, adc_chars);
-
-    // Set up the PWM timer configuration with a 50 Hz frequency and 12-bit resolution.
-    ledc_timer_config_t pwm_timer = {
-        .speed_mode = LEDC_LOW_SPEED_MODE,
-        .timer_num = LEDC_TIMER_0,
-        .freq_hz = 50,
-        .duty_resolution = LEDC_TIMER_12_BIT,
-        .clk_cfg = LEDC_AUTO_CLK,
-    };
-    ESP_ERROR_CHECK(ledc_timer_config(&pwm_timer));
-
-    // Configure the PWM channel tied to the defined servo pin.
-    ledc_channel_config_t pwm_channel = {
-        .gpio_num = SERVO_PIN,
-        .speed_mode = LEDC_LOW_SPEED_MODE,
-        .channel = LEDC_CHANNEL_0,
-        .timer_sel = LEDC_TIMER_0,
-        .duty = 0,  // Start with a duty cycle of 0 to prevent unwanted movement.
-        .hpoint = 0,
-        .intr_type = LEDC_INTR_DISABLE,
-    };
-    ESP_ERROR_CHECK(ledc_channel_config(&pwm_channel));
+// Oversample by 4, remove single-sample spikes, then low-pass with alpha = 1/8.
+static const adc_filter_stage_t pot_filter_stages[] = {
+    {ADC_FILTER_DECIMATE, 2},
+    {ADC_FILTER_MEDIAN, 3},
+    {ADC_FILTER_IIR, 3},
+};
+
+static adc_dma_source_t dma_source;  // DMA-backed sample source.
+static adc_sampler_t sampler;  // Ring of sample frames filled from the DMA.
+static adc_scan_t scan;  // Per-channel struct-of-arrays buffers fed from the sampler.
+static TaskHandle_t processing_task_handle;  // Task woken with the bits of channels that completed a block.
 
-    // Continuously read the potentiometer value and adjust the servo position.
+// Acquisition task: keeps the DMA drained, sorts samples per channel and wakes the processing core.
+static void acquisition_task(void *arg) {
     while (true) {
-        uint32_t pot_value = adc1_get_raw(POTENTIOMETER_ADC_CHANNEL);
-        uint32_t pwm_value = ((pot_value * (PWM_2_MS_VALUE - PWM_1_MS_VALUE)) / MAX_ADC_VALUE) + PWM_1_MS_VALUE;
+        if (!adc_sampler_pump(&sampler, portMAX_DELAY)) {
+            continue;
+        }
+        uint32_t completed = 0;
+        const adc_sample_frame_t *frame;
+        while ((frame = adc_sampler_acquire(&sampler)) != NULL) {
+            completed |= adc_scan_demux(&scan, frame->samples, frame->count, frame->timestamp_us);
+            adc_sampler_release(&sampler);
+        }
+        if (completed) {
+            xTaskNotify(processing_task_handle, completed, eSetBits);
+        }
+    }
+}
+
+// Processing task: filters every completed channel block and drives the servo from the potentiometer.
+static void processing_task(void *arg) {
+    uint64_t stats_cycles = 0;  // CPU cycles spent on blocks since the last statistics report.
+    uint64_t stats_map_cycles = 0;  // CPU cycles spent in the mapping stage and LEDC writes.
+    uint32_t stats_blocks = 0;  // Blocks consumed since the last statistics report.
+    uint32_t stats_servo_updates = 0;  // Potentiometer blocks since the last statistics report.
+    uint32_t blocks = 0;  // All blocks so far, picks which ones are traced.
+    uint64_t stats_samples = sampler.stats.samples;  // Sampler counter at the last report.
+    int64_t stats_start = esp_timer_get_time();
+
+    while (true) {
+        uint32_t notified;
+        xTaskNotifyWait(0, UINT32_MAX, &notified, portMAX_DELAY);  // Sleep until at least one block is ready.
+
+        uint32_t ready = adc_scan_ready(&scan);
+        for (uint8_t slot = 0; slot < NUM_SCAN_CHANNELS; slot++) {
+            if (!(ready & (1u << slot))) {
+                continue;
+            }
+            uint32_t start_cycles = esp_cpu_get_cycle_count();
 
-        // Update the PWM duty cycle with the calculated value.
-        ledc_set_duty(pwm_channel.speed_mode, pwm_channel.channel, pwm_value);
-        ledc_update_duty(pwm_channel.speed_mode, pwm_channel.channel);
+            // Filter the whole block and keep the newest output as the channel's value.
+            const int32_t *filtered;
+            size_t filtered_count = adc_filter_chain_run(&channel_filters[slot], NULL, adc_scan_block(&scan, slot),
+                                                         ADC_SCAN_BLOCK, &filtered);
+            channel_values[slot] = filtered[filtered_count - 1];
 
-        // Log the current potentiometer and PWM values.
-        ESP_LOGI(TAG, "Potentiometer Value: %lu, PWM Value: %lu", pot_value, pwm_value);
-        vTaskDelay(pdMS_TO_TICKS(100));  // Delay to stabilize readings.
+            if (slot == POTENTIOMETER_SLOT) {
+                // Map through the table and only touch the LEDC peripheral when the duty actually changes.
+                uint32_t map_cycles = esp_cpu_get_cycle_count();
+                uint32_t pwm_value;
+                bool changed = servo_stage_update(&servo_stage, channel_values[slot], &pwm_value);
+                if (changed) {
+                    uint16_t servo_frame[NUM_SERVOS] = { pwm_value };
+                    servo_engine_apply(&servo_engine, servo_frame);
+                }
+                map_cycles = esp_cpu_get_cycle_count() - map_cycles;
+                if (changed) {
+                    trace_emit(TRACE_SERVO_UPDATE, pwm_value, map_cycles);  // Only real writes are traced.
+                }
+                stats_map_cycles += map_cycles;
+                stats_servo_updates++;
+            }
+
+            uint32_t block_cycles = esp_cpu_get_cycle_count() - start_cycles;
+            if (blocks++ % TRACE_BLOCK_EVERY == 0) {
+                trace_emit(TRACE_ADC_BLOCK, slot, block_cycles);
+            }
+            stats_cycles += block_cycles;
+            stats_blocks++;
+            adc_scan_block_done(&scan, slot, esp_timer_get_time());
+        }
+
+        // Report throughput and jitter once per interval instead of logging every sample.
+        int64_t now = esp_timer_get_time();
+        if (now - stats_start >= STATS_INTERVAL_US && stats_blocks > 0) {
+            ESP_LOGI(TAG, "%u channels: %llu samples/s, %llu cycles/block, %lu frames dropped, %lu DMA overruns",
+                     (unsigned)NUM_SCAN_CHANNELS, (sampler.stats.samples - stats_samples) * 1000000 / (now - stats_start),
+                     stats_cycles / stats_blocks, sampler.stats.dropped_frames, dma_source.overruns);
+            for (uint8_t slot = 0; slot < NUM_SCAN_CHANNELS; slot++) {
+                const adc_scan_channel_stats_t *ch = &scan.stats[slot];
+                uint32_t rate = adc_scan_channel_rate(&scan, slot);
+                ESP_LOGI(TAG, "  ch%u: value %ld, %lu Hz, block every %lu us (min %lld, max %lld, jitter %lld us), pickup max %lld us, %lu overruns",
+                         scan_channels[slot].channel, channel_values[slot], rate, (uint32_t)(ADC_SCAN_BLOCK * 1000000ull / rate),
+                         ch->interval_min_us, ch->interval_max_us, ch->interval_max_us - ch->interval_min_us, ch->latency_max_us, ch->overruns);
+            }
+            if (stats_servo_updates > 0) {
+                ESP_LOGI(TAG, "Servo: potentiometer %u mV, duty %u, %llu cycles/update, %lu writes, %lu suppressed",
+                         adc_cal_to_mv(&adc_cal, channel_values[POTENTIOMETER_SLOT]), servo_stage.duty,
+                         stats_map_cycles / stats_servo_updates, servo_stage.writes, servo_stage.suppressed);
+            }
+            const servo_engine_stats_t *engine = &servo_engine.stats;
+            if (engine->frames > 0) {
+                ESP_LOGI(TAG, "Engine: %lu frames, %lu writes, %lu fades, %lu unchanged, apply avg %lld us, max %lld us, "
+                         "%lu boundary waits, %lu split",
+                         engine->frames, engine->writes, engine->fades, engine->unchanged,
+                         engine->apply_us_total / engine->frames, engine->apply_us_max, servo_ledc.boundary_waits,
+                         servo_ledc.split_bursts);
+            }
+            stats_cycles = 0;
+            stats_map_cycles = 0;
+            stats_blocks = 0;
+            stats_servo_updates = 0;
+            stats_samples = sampler.stats.samples;
+            stats_start = now;
+        }
     }
 }
 
+void app_main(void) {
+    trace_emit_boot();  // First record of the boot, so trace_decode splits sessions here.
+
+    // Evaluate the ADC calibration once per raw code into a lookup table and set up the filters.
+    adc_cal_table_init(&adc_cal, ADC_UNIT_1, ADC_ATTEN_DB_11, ADC_WIDTH_BIT_12, 1100);
+    for (uint8_t slot = 0; slot < NUM_SCAN_CHANNELS; slot++) {
+        adc_filter_chain_init(&channel_filters[slot], pot_filter_stages, sizeof(pot_filter_stages) / sizeof(pot_filter_stages[0]));
+    }
+
+    // Let the output engine configure the PWM timers and channels with the same frequency
+    // and resolution the duty table was generated for. Channels start at a duty of 0.
+    ESP_ERROR_CHECK(servo_engine_ledc_init(&servo_ledc, servo_pins, NUM_SERVOS, SERVO_PWM_FREQ_HZ, SERVO_PWM_RESOLUTION_BITS));
+    servo_engine_backend_t servo_backend = servo_engine_ledc_backend(&servo_ledc);
+    servo_engine_config_t servo_config = {
+        .num_channels = NUM_SERVOS,
+        .fade_threshold = 0,  // The slew limiter already keeps every move short, so no hardware fades here.
+        .fade_time_ms = 0,
+    };
+    servo_engine_init(&servo_engine, &servo_backend, &servo_config);
+    servo_stage_init(&servo_stage, SERVO_DEADBAND, SERVO_MAX_STEP, 0);
+    // The stage starts at the raw-0 pulse, so write that once; otherwise a potentiometer resting
+    // within the deadband of 0 would never report a change and the servo would never get a pulse.
+    uint16_t initial_frame[NUM_SERVOS] = { servo_stage.duty };
+    servo_engine_apply(&servo_engine, initial_frame);
+
+    // Build the scan pattern from the channel list and start continuous sampling with it.
+    if (!adc_scan_init(&scan, scan_channels, NUM_SCAN_CHANNELS, ADC_SAMPLE_RATE_HZ)) {
+        ESP_LOGE(TAG, "Invalid ADC scan channel list");
+        return;
+    }
+    adc_dma_source_init_pattern(&dma_source, scan.pattern, scan.pattern_len, ADC_SAMPLE_RATE_HZ);
+    adc_sample_source_t source = adc_dma_source(&dma_source);
+    adc_sampler_init(&sampler, &source);
+    if (!adc_sampler_start(&sampler)) {
+        ESP_LOGE(TAG, "Failed to start continuous ADC sampling");
+        return;
+    }
+
+    // Trace records are printed as "#T" hex lines; decode a capture with Common/Tools/trace_decode.
+    trace_start_drain_task(TRACE_DRAIN_PERIOD_MS, 1);
+
+    // Acquisition and processing run on separate cores so filtering never delays draining the DMA.
+    xTaskCreatePinnedToCore(processing_task, "processing_task", 4096, NULL, 10, &processing_task_handle, PROCESSING_CORE);
+    xTaskCreatePinnedToCore(acquisition_task, "acquisition_task", 2048, NULL, 12, NULL, ACQUISITION_CORE);
+}
 
 // Final Tips and Best Practices
 // 1. Calibration Accuracy: Always ensure your ADC is well-calibrated to maintain accuracy in readings.
 // 2. PWM Frequency: Be mindful of the PWM frequency settings as they directly affect the smoothness of servo movement.
-// 3. Debugging: Use ESP_LOGI for regular status updates to help with debugging and ensuring your setup operates as expected.
-// 4. Safety First: Initializing the PWM duty to 0 can help prevent any sudden or unexpected movements when the system powers up.
+// 3. Debugging: Keep ESP_LOGI for per-interval summaries; in the per-block path emit binary trace records and decode them on the host.
+// 4. Safety First: The channels start at a duty of 0 (no pulse), then get one defined pulse width before the loop starts, so the servo never sees a random position at power-up.
 // 5. Resource Management: Remember to free allocated resources if you modify the application to include exit conditions or error handling.
 // 6. Testing and Verification: Regularly test the full range of your potentiometer and servo to ensure they operate within expected parameters and make adjustments as needed.
 
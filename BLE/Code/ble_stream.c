@@ -0,0 +1,343 @@
+#include <string.h>
+#include "ble_stream.h"
+
+#define QUEUE_MASK (BLE_STREAM_QUEUE_BATCHES - 1)
+
+_Static_assert((BLE_STREAM_QUEUE_BATCHES & QUEUE_MASK) == 0, "BLE_STREAM_QUEUE_BATCHES must be a power of two");
+_Static_assert((BLE_STREAM_MAX_PAYLOAD - BLE_STREAM_HEADER_SIZE) / BLE_STREAM_SAMPLE_SIZE <= 255, "Sample count must fit in one byte");
+
+static inline void put_u16(uint8_t *p, uint16_t v) {
+    p[0] = v & 0xFF;
+    p[1] = v >> 8;
+}
+
+static inline uint16_t get_u16(const uint8_t *p) {
+    return p[0] | (p[1] << 8);
+}
+
+void ble_stream_init(ble_stream_t *stream, const ble_stream_link_t *link) {
+    memset(stream, 0, sizeof(*stream));
+    stream->link = *link;
+}
+
+// ---------------------------------------------------------------------------
+// Connection state (GATT server callback)
+// ---------------------------------------------------------------------------
+
+static ble_stream_conn_t *find_conn(ble_stream_t *stream, uint16_t conn_id) {
+    for (uint8_t i = 0; i < BLE_STREAM_MAX_CONN; i++) {
+        if (stream->conns[i].in_use && stream->conns[i].conn_id == conn_id) {
+            return &stream->conns[i];
+        }
+    }
+    return NULL;
+}
+
+void ble_stream_connect(ble_stream_t *stream, uint16_t conn_id) {
+    if (find_conn(stream, conn_id)) {
+        return;
+    }
+    for (uint8_t i = 0; i < BLE_STREAM_MAX_CONN; i++) {
+        ble_stream_conn_t *conn = &stream->conns[i];
+        if (!conn->in_use) {
+            conn->conn_id = conn_id;
+            conn->mtu = BLE_STREAM_DEFAULT_MTU;
+            conn->notify = false;
+            conn->congested = false;
+            conn->in_flight = 0;
+            __atomic_store_n(&conn->in_use, true, __ATOMIC_RELEASE);
+            return;
+        }
+    }
+}
+
+void ble_stream_disconnect(ble_stream_t *stream, uint16_t conn_id) {
+    ble_stream_conn_t *conn = find_conn(stream, conn_id);
+    if (conn) {
+        // Confirmations for this link will never arrive, so its credits go
+        // with it. Other connections keep theirs.
+        __atomic_store_n(&conn->notify, false, __ATOMIC_RELEASE);
+        __atomic_store_n(&conn->in_flight, 0, __ATOMIC_RELEASE);
+        __atomic_store_n(&conn->in_use, false, __ATOMIC_RELEASE);
+    }
+}
+
+void ble_stream_set_mtu(ble_stream_t *stream, uint16_t conn_id, uint16_t mtu) {
+    ble_stream_conn_t *conn = find_conn(stream, conn_id);
+    if (conn) {
+        mtu = mtu > BLE_STREAM_MAX_MTU ? BLE_STREAM_MAX_MTU : mtu;
+        __atomic_store_n(&conn->mtu, mtu, __ATOMIC_RELEASE);
+    }
+}
+
+void ble_stream_set_cccd(ble_stream_t *stream, uint16_t conn_id, uint16_t cccd_value) {
+    ble_stream_conn_t *conn = find_conn(stream, conn_id);
+    if (conn) {
+        __atomic_store_n(&conn->notify, (cccd_value & 0x0001) != 0, __ATOMIC_RELEASE);
+    }
+}
+
+void ble_stream_set_congested(ble_stream_t *stream, uint16_t conn_id, bool congested) {
+    ble_stream_conn_t *conn = find_conn(stream, conn_id);
+    if (conn) {
+        __atomic_store_n(&conn->congested, congested, __ATOMIC_RELEASE);
+        if (congested) {
+            stream->stats.congestion_events++;
+        }
+    }
+}
+
+void ble_stream_on_sent(ble_stream_t *stream, uint16_t conn_id) {
+    ble_stream_conn_t *conn = find_conn(stream, conn_id);
+    if (conn && __atomic_load_n(&conn->in_flight, __ATOMIC_ACQUIRE) > 0) {
+        __atomic_fetch_sub(&conn->in_flight, 1, __ATOMIC_RELEASE);
+    }
+}
+
+static inline bool conn_subscribed(const ble_stream_conn_t *conn) {
+    return __atomic_load_n(&conn->in_use, __ATOMIC_ACQUIRE) && __atomic_load_n(&conn->notify, __ATOMIC_ACQUIRE);
+}
+
+bool ble_stream_active(const ble_stream_t *stream) {
+    for (uint8_t i = 0; i < BLE_STREAM_MAX_CONN; i++) {
+        if (conn_subscribed(&stream->conns[i])) {
+            return true;
+        }
+    }
+    return false;
+}
+
+static uint32_t in_flight_total(const ble_stream_t *stream) {
+    uint32_t total = 0;
+    for (uint8_t i = 0; i < BLE_STREAM_MAX_CONN; i++) {
+        if (__atomic_load_n(&stream->conns[i].in_use, __ATOMIC_ACQUIRE)) {
+            total += __atomic_load_n(&stream->conns[i].in_flight, __ATOMIC_ACQUIRE);
+        }
+    }
+    return total;
+}
+
+// Largest notification every subscribed connection can take, 0 if none.
+static uint16_t payload_limit(const ble_stream_t *stream) {
+    uint16_t limit = 0;
+    for (uint8_t i = 0; i < BLE_STREAM_MAX_CONN; i++) {
+        const ble_stream_conn_t *conn = &stream->conns[i];
+        if (conn_subscribed(conn)) {
+            uint16_t payload = __atomic_load_n(&conn->mtu, __ATOMIC_ACQUIRE) - BLE_STREAM_ATT_OVERHEAD;
+            limit = (limit == 0 || payload < limit) ? payload : limit;
+        }
+    }
+    return limit;
+}
+
+// ---------------------------------------------------------------------------
+// Sampling side
+// ---------------------------------------------------------------------------
+
+static void close_batch(ble_stream_t *stream) {
+    ble_stream_batch_t *batch = stream->building;
+    uint8_t count = (batch->len - BLE_STREAM_HEADER_SIZE) / BLE_STREAM_SAMPLE_SIZE;
+    batch->data[2] = count;
+    stream->building = NULL;
+    stream->seq++;
+
+    if (batch == &stream->scratch) {
+        stream->stats.dropped_batches++;
+        stream->stats.dropped_samples += count;
+        return;
+    }
+    __atomic_store_n(&stream->head, stream->head + 1, __ATOMIC_RELEASE);
+}
+
+static bool start_batch(ble_stream_t *stream, uint32_t timestamp_ms) {
+    uint16_t limit = payload_limit(stream);
+    if (limit < BLE_STREAM_HEADER_SIZE + BLE_STREAM_SAMPLE_SIZE) {
+        return false;
+    }
+
+    // Pick the destination once per batch so a half-filled batch never moves.
+    uint32_t tail = __atomic_load_n(&stream->tail, __ATOMIC_ACQUIRE);
+    bool full = (stream->head - tail) >= BLE_STREAM_QUEUE_BATCHES;
+    ble_stream_batch_t *batch = full ? &stream->scratch : &stream->batches[stream->head & QUEUE_MASK];
+
+    batch->capacity = limit;
+    batch->len = BLE_STREAM_HEADER_SIZE;
+    put_u16(&batch->data[0], stream->seq);
+    batch->data[2] = 0;
+    batch->data[3] = 0;
+    put_u16(&batch->data[4], timestamp_ms & 0xFFFF);
+    put_u16(&batch->data[6], timestamp_ms >> 16);
+    stream->base_ms = timestamp_ms;
+    stream->building = batch;
+    return true;
+}
+
+bool ble_stream_push(ble_stream_t *stream, uint32_t timestamp_ms, uint16_t value) {
+    bool closed = false;
+
+    if (stream->building) {
+        // A client with a smaller MTU may have subscribed since the batch started.
+        uint16_t limit = payload_limit(stream);
+        if (limit != 0 && limit < stream->building->capacity) {
+            stream->building->capacity = limit;
+        }
+        // Close early if the sample no longer fits or its offset would not fit in 16 bits.
+        if (stream->building->len + BLE_STREAM_SAMPLE_SIZE > stream->building->capacity ||
+            timestamp_ms - stream->base_ms > 0xFFFF) {
+            close_batch(stream);
+            closed = true;
+        }
+    }
+    if (stream->building == NULL && !start_batch(stream, timestamp_ms)) {
+        return closed;  // Nobody is subscribed.
+    }
+
+    ble_stream_batch_t *batch = stream->building;
+    put_u16(&batch->data[batch->len], timestamp_ms - stream->base_ms);
+    put_u16(&batch->data[batch->len + 2], value);
+    batch->len += BLE_STREAM_SAMPLE_SIZE;
+
+    if (batch->len + BLE_STREAM_SAMPLE_SIZE > batch->capacity) {
+        close_batch(stream);
+        closed = true;
+    }
+    return closed;
+}
+
+bool ble_stream_flush_due(ble_stream_t *stream, uint32_t now_ms, uint32_t max_age_ms) {
+    if (stream->building == NULL || now_ms - stream->base_ms < max_age_ms) {
+        return false;
+    }
+    close_batch(stream);
+    return true;
+}
+
+uint32_t ble_stream_batch_samples(const ble_stream_t *stream) {
+    uint16_t limit = stream->building ? stream->building->capacity : payload_limit(stream);
+    return limit < BLE_STREAM_HEADER_SIZE ? 0 : (limit - BLE_STREAM_HEADER_SIZE) / BLE_STREAM_SAMPLE_SIZE;
+}
+
+// ---------------------------------------------------------------------------
+// Sending side
+// ---------------------------------------------------------------------------
+
+// Hand one notification to every subscriber. Returns true if at least one
+// connection's stack accepted it.
+static bool send_to_subscribers(ble_stream_t *stream, const uint8_t *data, size_t len) {
+    bool delivered = false;
+    for (uint8_t i = 0; i < BLE_STREAM_MAX_CONN; i++) {
+        ble_stream_conn_t *conn = &stream->conns[i];
+        if (!conn_subscribed(conn)) {
+            continue;
+        }
+        if (!stream->link.send(stream->link.ctx, conn->conn_id, data, len)) {
+            stream->stats.send_errors++;
+            continue;
+        }
+        __atomic_fetch_add(&conn->in_flight, 1, __ATOMIC_RELEASE);
+        delivered = true;
+    }
+    return delivered;
+}
+
+// Encode up to per_part samples of a batch, starting at sample first, as a
+// notification of its own: same seq, base_ms moved to its first sample.
+static size_t encode_part(ble_stream_t *stream, const ble_stream_batch_t *batch, uint8_t first, uint8_t per_part) {
+    uint8_t count = batch->data[2] - first;
+    count = count < per_part ? count : per_part;
+    const uint8_t *src = &batch->data[BLE_STREAM_HEADER_SIZE + (size_t)first * BLE_STREAM_SAMPLE_SIZE];
+    uint16_t shift = get_u16(src);
+    uint32_t base_ms = (get_u16(&batch->data[4]) | ((uint32_t)get_u16(&batch->data[6]) << 16)) + shift;
+
+    uint8_t *dst = stream->part_data;
+    dst[0] = batch->data[0];
+    dst[1] = batch->data[1];
+    dst[2] = count;
+    dst[3] = stream->part;
+    put_u16(&dst[4], base_ms & 0xFFFF);
+    put_u16(&dst[6], base_ms >> 16);
+    for (uint8_t i = 0; i < count; i++) {
+        const uint8_t *sample = &src[i * BLE_STREAM_SAMPLE_SIZE];
+        uint8_t *out = &dst[BLE_STREAM_HEADER_SIZE + i * BLE_STREAM_SAMPLE_SIZE];
+        put_u16(out, get_u16(sample) - shift);
+        put_u16(out + 2, get_u16(sample + 2));
+    }
+    return BLE_STREAM_HEADER_SIZE + (size_t)count * BLE_STREAM_SAMPLE_SIZE;
+}
+
+uint32_t ble_stream_service(ble_stream_t *stream) {
+    uint32_t sent = 0;
+
+    while (stream->tail != __atomic_load_n(&stream->head, __ATOMIC_ACQUIRE)) {
+        bool congested = false;
+        uint8_t subscribers = 0;
+        for (uint8_t i = 0; i < BLE_STREAM_MAX_CONN; i++) {
+            if (conn_subscribed(&stream->conns[i])) {
+                subscribers++;
+                congested |= __atomic_load_n(&stream->conns[i].congested, __ATOMIC_ACQUIRE);
+            }
+        }
+        if (subscribers == 0) {
+            // Everyone unsubscribed; the queued batches have no destination.
+            __atomic_store_n(&stream->tail, __atomic_load_n(&stream->head, __ATOMIC_ACQUIRE), __ATOMIC_RELEASE);
+            stream->part = 0;
+            stream->part_first = 0;
+            break;
+        }
+        if (congested) {
+            break;  // Resume on the stack's uncongested event.
+        }
+        if (in_flight_total(stream) + subscribers > BLE_STREAM_MAX_IN_FLIGHT) {
+            stream->stats.credit_stalls++;
+            break;  // Resume when a confirmation returns a credit.
+        }
+
+        // A batch closed before a smaller-MTU client subscribed goes out in
+        // parts that fit every subscriber.
+        const ble_stream_batch_t *batch = &stream->batches[stream->tail & QUEUE_MASK];
+        const uint8_t *data = batch->data;
+        size_t len = batch->len;
+        uint16_t limit = payload_limit(stream);
+        bool split = stream->part_first > 0 || len > limit;
+        if (split) {
+            uint8_t per_part = (limit - BLE_STREAM_HEADER_SIZE) / BLE_STREAM_SAMPLE_SIZE;
+            len = encode_part(stream, batch, stream->part_first, per_part);
+            data = stream->part_data;
+        }
+        if (!send_to_subscribers(stream, data, len)) {
+            break;  // Every subscriber's stack refused it; retry on the next call.
+        }
+
+        int64_t now = stream->link.now_us(stream->link.ctx);
+        if (stream->stats.packets == 0) {
+            stream->stats.first_send_us = now;
+        }
+        stream->stats.last_send_us = now;
+        stream->stats.packets++;
+        stream->stats.bytes += len;
+        stream->stats.samples += data[2];
+        sent++;
+
+        if (split) {
+            stream->stats.split_batches += stream->part == 0;
+            stream->part++;
+            stream->part_first += data[2];
+            if (stream->part_first < batch->data[2]) {
+                continue;  // More parts of this batch to go.
+            }
+            stream->part = 0;
+            stream->part_first = 0;
+        }
+        __atomic_store_n(&stream->tail, stream->tail + 1, __ATOMIC_RELEASE);
+    }
+    return sent;
+}
+
+uint32_t ble_stream_throughput_bps(const ble_stream_t *stream) {
+    int64_t elapsed = stream->stats.last_send_us - stream->stats.first_send_us;
+    return elapsed > 0 ? (uint32_t)(stream->stats.bytes * 1000000 / elapsed) : 0;
+}
+
+uint32_t ble_stream_samples_per_packet_x100(const ble_stream_t *stream) {
+    return stream->stats.packets ? (uint32_t)((uint64_t)stream->stats.samples * 100 / stream->stats.packets) : 0;
+}
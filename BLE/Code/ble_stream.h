@@ -0,0 +1,126 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// Notification streaming for a GATT characteristic.
+//
+// The sampling side packs timestamped samples into batches sized to the
+// smallest MTU negotiated by the subscribed connections, so every
+// notification carries as many samples as fit. Closed batches wait in a small
+// ring until the sending side hands them to the stack. The sender keeps a
+// bounded number of notifications in flight: each send takes a credit from
+// its connection, each confirmation from the stack returns it, and nothing is
+// sent while a connection reports congestion. If the ring is full when a
+// batch closes, the batch is dropped and counted instead of blocking the
+// sampler. A batch queued before a smaller-MTU client subscribed is split
+// into parts that fit every subscriber.
+//
+// Notification layout (multi-byte fields little endian):
+//
+//   0   seq (u16)         increments per batch, including dropped ones
+//   2   count             number of samples
+//   3   part              index of this notification within a split batch, 0 otherwise
+//   4   base_ms (u32)     timestamp of the first sample
+//   8   count x { offset_ms (u16), value (u16) }
+
+#define BLE_STREAM_MAX_CONN 3  // Bluedroid's default connection limit.
+#define BLE_STREAM_DEFAULT_MTU 23  // ATT MTU before an exchange.
+#define BLE_STREAM_MAX_MTU 512
+#define BLE_STREAM_ATT_OVERHEAD 3  // Opcode and handle in every notification.
+#define BLE_STREAM_MAX_PAYLOAD (BLE_STREAM_MAX_MTU - BLE_STREAM_ATT_OVERHEAD)
+#define BLE_STREAM_HEADER_SIZE 8
+#define BLE_STREAM_SAMPLE_SIZE 4
+#define BLE_STREAM_QUEUE_BATCHES 4  // Closed batches waiting to be sent, must be a power of two.
+#define BLE_STREAM_MAX_IN_FLIGHT 4  // Notifications handed to the stack but not yet confirmed.
+
+typedef struct {
+    uint16_t len;  // Encoded length, header included.
+    uint16_t capacity;  // Payload limit when the batch was started.
+    uint8_t data[BLE_STREAM_MAX_PAYLOAD];
+} ble_stream_batch_t;
+
+typedef struct {
+    bool in_use;
+    bool notify;  // Client enabled notifications through the CCCD.
+    bool congested;
+    uint16_t conn_id;
+    uint16_t mtu;
+    uint8_t in_flight;  // Notifications to this connection not yet confirmed.
+} ble_stream_conn_t;
+
+typedef struct {
+    uint64_t bytes;  // Payload bytes the stack accepted for at least one subscriber.
+    uint32_t packets;  // Notifications the stack accepted for at least one subscriber.
+    uint32_t samples;  // Samples in those notifications.
+    uint32_t split_batches;  // Batches split because a subscriber's MTU was smaller than the batch.
+    uint32_t dropped_batches;  // Batches discarded because the queue was full.
+    uint32_t dropped_samples;
+    uint32_t send_errors;  // Sends the stack refused, per connection.
+    uint32_t congestion_events;
+    uint32_t credit_stalls;  // Times sending paused with every credit in use.
+    int64_t first_send_us;
+    int64_t last_send_us;
+} ble_stream_stats_t;
+
+// Link to the GATT server. send() queues one notification for a connection
+// and returns false if the stack refused it.
+typedef struct {
+    bool (*send)(void *ctx, uint16_t conn_id, const uint8_t *data, size_t len);
+    int64_t (*now_us)(void *ctx);
+    void *ctx;
+} ble_stream_link_t;
+
+typedef struct {
+    ble_stream_link_t link;
+    ble_stream_conn_t conns[BLE_STREAM_MAX_CONN];
+
+    ble_stream_batch_t batches[BLE_STREAM_QUEUE_BATCHES];
+    ble_stream_batch_t scratch;  // Absorbs a batch while the queue is full.
+    ble_stream_batch_t *building;  // Batch being filled, NULL between batches.
+    uint32_t base_ms;  // Timestamp of the first sample in the building batch.
+    uint16_t seq;
+    uint32_t head;  // Batches closed, written by the sampling side only.
+    uint32_t tail;  // Batches sent, written by the sending side only.
+    uint8_t part;  // Next part of the tail batch while it is being sent in parts.
+    uint8_t part_first;  // First sample of that part.
+    uint8_t part_data[BLE_STREAM_MAX_PAYLOAD];  // Encoded part of a split batch.
+
+    ble_stream_stats_t stats;
+} ble_stream_t;
+
+void ble_stream_init(ble_stream_t *stream, const ble_stream_link_t *link);
+
+// Connection events from the GATT server callback.
+void ble_stream_connect(ble_stream_t *stream, uint16_t conn_id);
+void ble_stream_disconnect(ble_stream_t *stream, uint16_t conn_id);
+void ble_stream_set_mtu(ble_stream_t *stream, uint16_t conn_id, uint16_t mtu);
+void ble_stream_set_cccd(ble_stream_t *stream, uint16_t conn_id, uint16_t cccd_value);
+void ble_stream_set_congested(ble_stream_t *stream, uint16_t conn_id, bool congested);
+void ble_stream_on_sent(ble_stream_t *stream, uint16_t conn_id);
+
+// True while at least one connection has notifications enabled.
+bool ble_stream_active(const ble_stream_t *stream);
+
+// Sampling side: add one sample. Returns true when this closed a batch.
+bool ble_stream_push(ble_stream_t *stream, uint32_t timestamp_ms, uint16_t value);
+
+// Sampling side: close the building batch if its first sample is at least
+// max_age_ms old, so a slow signal still reaches the client. Returns true
+// when a batch was closed.
+bool ble_stream_flush_due(ble_stream_t *stream, uint32_t now_ms, uint32_t max_age_ms);
+
+// Samples a batch holds at the current payload limit: the building batch's
+// capacity, or the smallest subscribed MTU's between batches. 0 while nobody
+// is subscribed. Multiplied by the sample period it gives the age at which a
+// batch fills on its own, for choosing max_age_ms.
+uint32_t ble_stream_batch_samples(const ble_stream_t *stream);
+
+// Sending side: hand queued batches to the stack while credits last and no
+// connection is congested. Returns the number of notifications sent.
+uint32_t ble_stream_service(ble_stream_t *stream);
+
+// Derived statistics.
+uint32_t ble_stream_throughput_bps(const ble_stream_t *stream);  // Payload bytes per second since the first send.
+uint32_t ble_stream_samples_per_packet_x100(const ble_stream_t *stream);
@@ -0,0 +1,160 @@
+#include <string.h>
+#include "gatt_dispatch.h"
+#include "esp_cpu.h"
+#include "esp_log.h"
+
+static esp_gatts_cb_t app_callbacks[GATT_DISPATCH_MAX_APPS];
+static uint8_t num_apps;
+static uint8_t app_by_if[ESP_GATT_IF_NONE];  // gatts_if -> app_id + 1, 0 when unknown.
+static const gatt_attr_ops_t *ops_by_handle[GATT_DISPATCH_MAX_HANDLES];
+static gatt_event_stats_t event_stats[GATT_DISPATCH_MAX_EVENTS];
+
+void gatt_dispatch_init(const esp_gatts_cb_t *callbacks, uint8_t count) {
+    num_apps = count > GATT_DISPATCH_MAX_APPS ? GATT_DISPATCH_MAX_APPS : count;
+    memcpy(app_callbacks, callbacks, num_apps * sizeof(*callbacks));
+    memset(app_by_if, 0, sizeof(app_by_if));
+    memset(ops_by_handle, 0, sizeof(ops_by_handle));
+    memset(event_stats, 0, sizeof(event_stats));
+}
+
+void gatt_dispatch_map_attrs(const uint16_t *handles, const gatt_attr_ops_t *ops, uint16_t count) {
+    for (uint16_t i = 0; i < count; i++) {
+        if (handles[i] >= GATT_DISPATCH_MAX_HANDLES) {
+            ESP_LOGW("gatt_dispatch", "handle %u beyond the dispatch table, left to the app callback", handles[i]);
+            continue;
+        }
+        if (ops[i].on_read || ops[i].on_write) {
+            ops_by_handle[handles[i]] = &ops[i];
+        }
+    }
+}
+
+// Returns true when an attribute handler took the event.
+static bool dispatch_attr(esp_gatts_cb_event_t event, esp_gatt_if_t gatts_if, esp_ble_gatts_cb_param_t *param) {
+    if (event == ESP_GATTS_READ_EVT) {
+        uint16_t handle = param->read.handle;
+        const gatt_attr_ops_t *ops = handle < GATT_DISPATCH_MAX_HANDLES ? ops_by_handle[handle] : NULL;
+        if (ops == NULL || ops->on_read == NULL) {
+            return false;
+        }
+        esp_gatt_rsp_t rsp;
+        memset(&rsp, 0, sizeof(rsp));
+        rsp.attr_value.handle = handle;
+        esp_gatt_status_t status = ops->on_read(gatts_if, param, &rsp);
+        if (param->read.need_rsp) {
+            esp_ble_gatts_send_response(gatts_if, param->read.conn_id, param->read.trans_id, status, &rsp);
+        }
+        return true;
+    }
+
+    if (event == ESP_GATTS_WRITE_EVT && !param->write.is_prep) {
+        uint16_t handle = param->write.handle;
+        const gatt_attr_ops_t *ops = handle < GATT_DISPATCH_MAX_HANDLES ? ops_by_handle[handle] : NULL;
+        if (ops == NULL || ops->on_write == NULL) {
+            return false;
+        }
+        esp_gatt_status_t status = ops->on_write(gatts_if, param, NULL);
+        if (param->write.need_rsp) {
+            esp_ble_gatts_send_response(gatts_if, param->write.conn_id, param->write.trans_id, status, NULL);
+        }
+        return true;
+    }
+    return false;
+}
+
+void gatt_dispatch_event(esp_gatts_cb_event_t event, esp_gatt_if_t gatts_if, esp_ble_gatts_cb_param_t *param) {
+    uint32_t start = esp_cpu_get_cycle_count();
+
+    if (event == ESP_GATTS_REG_EVT) {
+        if (param->reg.status != ESP_GATT_OK || param->reg.app_id >= num_apps) {
+            ESP_LOGI("gatt_dispatch", "Reg app %d failed", param->reg.app_id);
+            return;
+        }
+        app_by_if[gatts_if] = param->reg.app_id + 1;
+    }
+
+    if (gatts_if == ESP_GATT_IF_NONE) {
+        for (uint8_t app = 0; app < num_apps; app++) {
+            if (app_callbacks[app]) {
+                app_callbacks[app](event, gatts_if, param);
+            }
+        }
+    } else if (!dispatch_attr(event, gatts_if, param)) {
+        uint8_t app = app_by_if[gatts_if];
+        if (app && app_callbacks[app - 1]) {
+            app_callbacks[app - 1](event, gatts_if, param);
+        }
+    }
+
+    uint32_t cycles = esp_cpu_get_cycle_count() - start;
+    gatt_event_stats_t *stats = &event_stats[event < GATT_DISPATCH_MAX_EVENTS ? event : GATT_DISPATCH_MAX_EVENTS - 1];
+    stats->count++;
+    stats->total_cycles += cycles;
+    if (cycles > stats->max_cycles) {
+        stats->max_cycles = cycles;
+    }
+}
+
+const gatt_event_stats_t *gatt_dispatch_stats(esp_gatts_cb_event_t event) {
+    return &event_stats[event < GATT_DISPATCH_MAX_EVENTS ? event : GATT_DISPATCH_MAX_EVENTS - 1];
+}
+
+void gatt_dispatch_log_stats(const char *tag) {
+    for (uint8_t event = 0; event < GATT_DISPATCH_MAX_EVENTS; event++) {
+        const gatt_event_stats_t *stats = &event_stats[event];
+        if (stats->count) {
+            ESP_LOGI(tag, "GATT event %2u: %lu dispatched, %llu cycles avg, %lu cycles max",
+                     event, stats->count, stats->total_cycles / stats->count, stats->max_cycles);
+        }
+    }
+}
+
+// ---------------------------------------------------------------------------
+// Deferred writes
+// ---------------------------------------------------------------------------
+
+bool gatt_write_queue_init(gatt_write_queue_t *writes, size_t length, size_t item_size, gatt_write_policy_t policy) {
+    memset(writes, 0, sizeof(*writes));
+    if (policy == GATT_WRITE_DROP_OLDEST && item_size > GATT_WRITE_MAX_DROP_OLDEST_ITEM) {
+        return false;  // The displaced item is received into a stack buffer.
+    }
+    writes->policy = policy;
+    writes->queue = xQueueCreate(policy == GATT_WRITE_KEEP_LATEST ? 1 : length, item_size);
+    return writes->queue != NULL;
+}
+
+bool gatt_write_queue_post(gatt_write_queue_t *writes, const void *item) {
+    switch (writes->policy) {
+    case GATT_WRITE_KEEP_LATEST:
+        // An item the worker has not picked up yet is superseded by this one.
+        if (uxQueueMessagesWaiting(writes->queue) > 0) {
+            writes->dropped++;
+        }
+        xQueueOverwrite(writes->queue, item);
+        writes->posted++;
+        return true;
+
+    case GATT_WRITE_DROP_OLDEST:
+        if (xQueueSend(writes->queue, item, 0) != pdTRUE) {
+            uint8_t oldest[GATT_WRITE_MAX_DROP_OLDEST_ITEM];
+            if (xQueueReceive(writes->queue, oldest, 0) == pdTRUE) {
+                writes->dropped++;
+            }
+            if (xQueueSend(writes->queue, item, 0) != pdTRUE) {
+                writes->dropped++;
+                return false;
+            }
+        }
+        writes->posted++;
+        return true;
+
+    case GATT_WRITE_DROP_NEWEST:
+    default:
+        if (xQueueSend(writes->queue, item, 0) != pdTRUE) {
+            writes->dropped++;
+            return false;
+        }
+        writes->posted++;
+        return true;
+    }
+}
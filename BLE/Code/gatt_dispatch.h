@@ -0,0 +1,83 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/queue.h"
+#include "esp_gatts_api.h"
+
+// GATT server event routing.
+//
+// Events reach the owning application through a table indexed by gatts_if,
+// and reads and writes go straight to per-attribute handlers through a table
+// indexed by attribute handle. Dispatch cost therefore does not grow with the
+// number of services or characteristics. Only events without an interface
+// (gatts_if == ESP_GATT_IF_NONE) are offered to every application.
+//
+// Everything here runs on the Bluetooth stack task, so handlers must not
+// block. Work that can wait goes to a worker task through a gatt_write_queue_t,
+// which never blocks and applies an explicit policy when the worker falls
+// behind.
+
+#define GATT_DISPATCH_MAX_APPS 4
+#define GATT_DISPATCH_MAX_HANDLES 128  // Attribute handles covered by the handle table.
+#define GATT_DISPATCH_MAX_EVENTS 40  // Event types with their own latency counters.
+
+// Per-attribute handler. Returns the status sent back to the client when the
+// stack asks the application to respond; a read handler fills rsp.
+typedef esp_gatt_status_t (*gatt_attr_cb_t)(esp_gatt_if_t gatts_if, esp_ble_gatts_cb_param_t *param, esp_gatt_rsp_t *rsp);
+
+typedef struct {
+    gatt_attr_cb_t on_read;
+    gatt_attr_cb_t on_write;
+} gatt_attr_ops_t;
+
+// Time the stack task spent in the dispatcher, per event type.
+typedef struct {
+    uint32_t count;
+    uint32_t max_cycles;
+    uint64_t total_cycles;
+} gatt_event_stats_t;
+
+// app_callbacks[app_id] handles everything for the application registered
+// with esp_ble_gatts_app_register(app_id) that no attribute handler claims.
+void gatt_dispatch_init(const esp_gatts_cb_t *app_callbacks, uint8_t num_apps);
+
+// Register this with esp_ble_gatts_register_callback().
+void gatt_dispatch_event(esp_gatts_cb_event_t event, esp_gatt_if_t gatts_if, esp_ble_gatts_cb_param_t *param);
+
+// Route reads and writes of handles[i] to ops[i], typically called with the
+// handle list from ESP_GATTS_CREAT_ATTR_TAB_EVT and an ops table in the same
+// index order. Entries without handlers are left to the application callback.
+void gatt_dispatch_map_attrs(const uint16_t *handles, const gatt_attr_ops_t *ops, uint16_t count);
+
+const gatt_event_stats_t *gatt_dispatch_stats(esp_gatts_cb_event_t event);
+
+// Log count, average and worst-case dispatch time for every event type seen.
+void gatt_dispatch_log_stats(const char *tag);
+
+// ---------------------------------------------------------------------------
+// Deferred writes
+// ---------------------------------------------------------------------------
+
+typedef enum {
+    GATT_WRITE_DROP_NEWEST,  // Queue full: discard the incoming item.
+    GATT_WRITE_DROP_OLDEST,  // Queue full: discard the oldest queued item to make room.
+    GATT_WRITE_KEEP_LATEST,  // Single slot that always holds the newest item.
+} gatt_write_policy_t;
+
+#define GATT_WRITE_MAX_DROP_OLDEST_ITEM 32  // Largest item a GATT_WRITE_DROP_OLDEST queue accepts.
+
+typedef struct {
+    QueueHandle_t queue;
+    gatt_write_policy_t policy;
+    uint32_t posted;  // Items accepted.
+    uint32_t dropped;  // Items discarded or overwritten by the policy.
+} gatt_write_queue_t;
+
+// GATT_WRITE_KEEP_LATEST always uses a length of one.
+bool gatt_write_queue_init(gatt_write_queue_t *writes, size_t length, size_t item_size, gatt_write_policy_t policy);
+
+// Never blocks. Returns false if this item was discarded.
+bool gatt_write_queue_post(gatt_write_queue_t *writes, const void *item);
@@ -0,0 +1,250 @@
+// Host test for ble_stream credits, failed sends and MTU changes.
+//
+// Build: gcc -O2 -I../Code -o ble_stream_test ble_stream_test.c ../Code/ble_stream.c
+// Usage: ./ble_stream_test
+//
+// Drives the stream through a fake GATT link that decodes every notification
+// per connection, confirms notifications on demand and can refuse sends.
+// Checks that:
+//   - a disconnect returns only the departing link's credits, so the links
+//     still connected never exceed BLE_STREAM_MAX_IN_FLIGHT,
+//   - a batch the stack refused everywhere is neither counted nor skipped,
+//   - batches queued before a smaller-MTU client subscribed reach it in parts
+//     that fit its MTU, and both clients see every sample once, in order,
+//   - ble_stream_batch_samples() follows the smallest subscribed MTU, so an
+//     age limit derived from it never closes a batch that is still filling.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include "ble_stream.h"
+
+#define MAX_SAMPLES 4096
+
+typedef struct {
+    uint16_t conn_id;
+    uint32_t outstanding;  // Sent but not yet confirmed.
+    uint32_t outstanding_max;
+    uint32_t notifications;
+    size_t len_max;
+    uint32_t count;
+    uint32_t timestamps[MAX_SAMPLES];
+    uint16_t values[MAX_SAMPLES];
+} fake_conn_t;
+
+typedef struct {
+    fake_conn_t conns[BLE_STREAM_MAX_CONN];
+    bool refuse;
+    int64_t now_us;
+} fake_link_t;
+
+static uint32_t failures;
+
+#define CHECK(cond, ...)              \
+    do {                              \
+        if (!(cond)) {                \
+            printf("FAIL: " __VA_ARGS__); \
+            printf("\n");             \
+            failures++;               \
+        }                             \
+    } while (0)
+
+static uint16_t get_u16(const uint8_t *p) {
+    return p[0] | (p[1] << 8);
+}
+
+static bool fake_send(void *ctx, uint16_t conn_id, const uint8_t *data, size_t len) {
+    fake_link_t *fake = ctx;
+    if (fake->refuse) {
+        return false;
+    }
+    fake_conn_t *conn = &fake->conns[conn_id];
+    conn->outstanding++;
+    conn->outstanding_max = conn->outstanding > conn->outstanding_max ? conn->outstanding : conn->outstanding_max;
+    conn->notifications++;
+    conn->len_max = len > conn->len_max ? len : conn->len_max;
+
+    uint32_t base_ms = get_u16(&data[4]) | ((uint32_t)get_u16(&data[6]) << 16);
+    for (uint8_t i = 0; i < data[2] && conn->count < MAX_SAMPLES; i++) {
+        const uint8_t *sample = &data[BLE_STREAM_HEADER_SIZE + i * BLE_STREAM_SAMPLE_SIZE];
+        conn->timestamps[conn->count] = base_ms + get_u16(sample);
+        conn->values[conn->count] = get_u16(sample + 2);
+        conn->count++;
+    }
+    return true;
+}
+
+static int64_t fake_now_us(void *ctx) {
+    fake_link_t *fake = ctx;
+    return fake->now_us += 1000;
+}
+
+// Confirm every outstanding notification on one connection.
+static void confirm_all(ble_stream_t *stream, fake_link_t *fake, uint16_t conn_id) {
+    while (fake->conns[conn_id].outstanding > 0) {
+        fake->conns[conn_id].outstanding--;
+        ble_stream_on_sent(stream, conn_id);
+    }
+}
+
+static void subscribe(ble_stream_t *stream, uint16_t conn_id, uint16_t mtu) {
+    ble_stream_connect(stream, conn_id);
+    ble_stream_set_mtu(stream, conn_id, mtu);
+    ble_stream_set_cccd(stream, conn_id, 0x0001);
+}
+
+static uint32_t next_sample;
+
+// Push samples until n batches have closed.
+static void push_batches(ble_stream_t *stream, uint32_t n) {
+    while (n > 0) {
+        if (ble_stream_push(stream, next_sample * 10, next_sample & 0x0FFF)) {
+            n--;
+        }
+        next_sample++;
+    }
+}
+
+static void init(ble_stream_t *stream, fake_link_t *fake) {
+    *fake = (fake_link_t){ 0 };
+    for (uint16_t i = 0; i < BLE_STREAM_MAX_CONN; i++) {
+        fake->conns[i].conn_id = i;
+    }
+    ble_stream_link_t link = { .send = fake_send, .now_us = fake_now_us, .ctx = fake };
+    ble_stream_init(stream, &link);
+    next_sample = 0;
+}
+
+static void test_disconnect_keeps_other_credits(void) {
+    static ble_stream_t stream;
+    static fake_link_t fake;
+    init(&stream, &fake);
+    subscribe(&stream, 0, 100);
+    subscribe(&stream, 1, 100);
+
+    push_batches(&stream, 2);
+    ble_stream_service(&stream);  // Two batches to two links: every credit in use.
+    CHECK(fake.conns[0].outstanding == 2, "link 0 holds %u credits, expected 2", fake.conns[0].outstanding);
+
+    ble_stream_disconnect(&stream, 1);
+    fake.conns[1].outstanding = 0;
+    for (int round = 0; round < 4; round++) {
+        push_batches(&stream, 1);
+        ble_stream_service(&stream);
+    }
+    CHECK(fake.conns[0].outstanding_max <= BLE_STREAM_MAX_IN_FLIGHT, "link 0 reached %u notifications in flight",
+          fake.conns[0].outstanding_max);
+
+    confirm_all(&stream, &fake, 0);
+    ble_stream_service(&stream);
+    confirm_all(&stream, &fake, 0);
+    ble_stream_service(&stream);
+    CHECK(stream.tail == stream.head, "%u batches left after credits returned", stream.head - stream.tail);
+    CHECK(fake.conns[0].count == stream.stats.samples, "link 0 got %u samples, stats say %u", fake.conns[0].count,
+          stream.stats.samples);
+}
+
+static void test_refused_send_is_retried(void) {
+    static ble_stream_t stream;
+    static fake_link_t fake;
+    init(&stream, &fake);
+    subscribe(&stream, 0, 100);
+
+    push_batches(&stream, 2);
+    fake.refuse = true;
+    ble_stream_service(&stream);
+    CHECK(stream.stats.packets == 0 && stream.stats.samples == 0, "refused sends counted as %u packets",
+          stream.stats.packets);
+    CHECK(stream.head - stream.tail == 2, "refused batch was skipped");
+    CHECK(stream.stats.send_errors == 1, "%u send errors, expected 1", stream.stats.send_errors);
+
+    fake.refuse = false;
+    ble_stream_service(&stream);
+    CHECK(stream.tail == stream.head, "batches not sent after the stack recovered");
+    CHECK(fake.conns[0].count == stream.stats.samples && stream.stats.packets == 2, "got %u samples in %u packets",
+          fake.conns[0].count, stream.stats.packets);
+    for (uint32_t i = 0; i < fake.conns[0].count; i++) {
+        CHECK(fake.conns[0].timestamps[i] == i * 10, "sample %u has timestamp %u", i, fake.conns[0].timestamps[i]);
+    }
+}
+
+static void test_small_mtu_joiner(void) {
+    static ble_stream_t stream;
+    static fake_link_t fake;
+    init(&stream, &fake);
+    subscribe(&stream, 0, 247);
+
+    push_batches(&stream, 2);  // Two 60-sample batches queued for the large MTU.
+    uint32_t large_samples = next_sample;
+    subscribe(&stream, 1, BLE_STREAM_DEFAULT_MTU);  // Takes 3 samples per notification.
+    push_batches(&stream, 3);  // The building batch shrinks to the new limit.
+
+    for (int round = 0; round < 200 && stream.tail != stream.head; round++) {
+        ble_stream_service(&stream);
+        confirm_all(&stream, &fake, 0);
+        confirm_all(&stream, &fake, 1);
+    }
+    CHECK(stream.tail == stream.head, "%u batches still queued", stream.head - stream.tail);
+    CHECK(stream.stats.send_errors == 0, "%u send errors", stream.stats.send_errors);
+    CHECK(stream.stats.split_batches == 2, "%u batches split, expected 2", stream.stats.split_batches);
+
+    size_t small_payload = BLE_STREAM_DEFAULT_MTU - BLE_STREAM_ATT_OVERHEAD;
+    CHECK(fake.conns[1].len_max <= small_payload, "small link got a %zu-byte notification", fake.conns[1].len_max);
+    CHECK(fake.conns[0].count == fake.conns[1].count && fake.conns[0].count == stream.stats.samples,
+          "links got %u and %u samples, stats say %u", fake.conns[0].count, fake.conns[1].count, stream.stats.samples);
+    CHECK(fake.conns[1].count > large_samples, "small link missed the new batches");
+    for (uint16_t c = 0; c < 2; c++) {
+        for (uint32_t i = 0; i < fake.conns[c].count; i++) {
+            if (fake.conns[c].timestamps[i] != i * 10 || fake.conns[c].values[i] != (i & 0x0FFF)) {
+                CHECK(false, "link %u sample %u is %u ms / %u", c, i, fake.conns[c].timestamps[i],
+                      fake.conns[c].values[i]);
+                break;
+            }
+        }
+    }
+    printf("small MTU joiner: %u samples in %u notifications, %u batches split\n", stream.stats.samples,
+           stream.stats.packets, stream.stats.split_batches);
+}
+
+static void test_batch_samples(void) {
+    static ble_stream_t stream;
+    static fake_link_t fake;
+    init(&stream, &fake);
+    CHECK(ble_stream_batch_samples(&stream) == 0, "batch size %u with nobody subscribed",
+          ble_stream_batch_samples(&stream));
+
+    subscribe(&stream, 0, 247);
+    uint32_t samples = ble_stream_batch_samples(&stream);
+    CHECK(samples == 59, "%u samples per batch at MTU 247, expected 59", samples);
+
+    // On schedule, the age limit is reached only as the batch closes full.
+    uint32_t max_age_ms = samples * 10;
+    bool early = false;
+    uint32_t closed = 0;
+    for (uint32_t i = 0; i < 10 * samples; i++) {
+        closed += ble_stream_push(&stream, next_sample * 10, 0);
+        early |= ble_stream_flush_due(&stream, next_sample * 10, max_age_ms);
+        next_sample++;
+    }
+    CHECK(!early && closed == 10, "%u batches closed full, age limit closed one early: %d", closed, early);
+
+    // A late sample is flushed by age.
+    ble_stream_push(&stream, next_sample * 10, 0);
+    CHECK(ble_stream_flush_due(&stream, next_sample * 10 + max_age_ms, max_age_ms), "stale batch not flushed");
+
+    subscribe(&stream, 1, BLE_STREAM_DEFAULT_MTU);
+    CHECK(ble_stream_batch_samples(&stream) == 3, "%u samples per batch at the default MTU, expected 3",
+          ble_stream_batch_samples(&stream));
+}
+
+int main(void) {
+    test_disconnect_keeps_other_credits();
+    test_refused_send_is_retried();
+    test_small_mtu_joiner();
+    test_batch_samples();
+    if (failures) {
+        printf("%u checks failed\n", failures);
+        return 1;
+    }
+    printf("all checks passed\n");
+    return 0;
+}
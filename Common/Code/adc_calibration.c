@@ -0,0 +1,155 @@
+#include <string.h>
+#include "adc_calibration.h"
+
+#define MASK_12BIT (ADC_CAL_TABLE_SIZE - 1)
+
+// Branch-free helpers; GCC turns these into min/max or conditional moves.
+static inline int32_t min_i32(int32_t a, int32_t b) { return a < b ? a : b; }
+static inline int32_t max_i32(int32_t a, int32_t b) { return a > b ? a : b; }
+
+static inline int32_t median3(int32_t a, int32_t b, int32_t c) {
+    return max_i32(min_i32(a, b), min_i32(max_i32(a, b), c));
+}
+
+static inline int32_t median5(int32_t a, int32_t b, int32_t c, int32_t d, int32_t e) {
+    // Dropping the smallest and largest of a..d cannot remove the median of all five.
+    int32_t lo = max_i32(min_i32(a, b), min_i32(c, d));
+    int32_t hi = min_i32(max_i32(a, b), max_i32(c, d));
+    return median3(lo, hi, e);
+}
+
+uint32_t adc_cal_linear_to_mv(const adc_cal_table_t *table, uint32_t raw) {
+    return ((raw & MASK_12BIT) * table->coeff_a + 32768) / 65536 + table->coeff_b;
+}
+
+void adc_cal_table_build_linear(adc_cal_table_t *table, uint32_t coeff_a, uint32_t coeff_b) {
+    table->coeff_a = coeff_a;
+    table->coeff_b = coeff_b;
+    for (uint32_t raw = 0; raw < ADC_CAL_TABLE_SIZE; raw++) {
+        table->mv[raw] = (uint16_t)adc_cal_linear_to_mv(table, raw);
+    }
+}
+
+void adc_cal_apply(const adc_cal_table_t *table, const uint16_t *samples, uint16_t *mv, size_t count) {
+    for (size_t i = 0; i < count; i++) {
+        mv[i] = table->mv[samples[i] & MASK_12BIT];
+    }
+}
+
+void adc_filter_chain_init(adc_filter_chain_t *chain, const adc_filter_stage_t *stages, size_t num_stages) {
+    memset(chain, 0, sizeof(*chain));
+    if (num_stages > ADC_FILTER_MAX_STAGES) {
+        num_stages = ADC_FILTER_MAX_STAGES;
+    }
+    memcpy(chain->stages, stages, num_stages * sizeof(*stages));
+    chain->num_stages = num_stages;
+}
+
+static size_t run_decimate(const int32_t *restrict src, int32_t *restrict dst, size_t count, uint8_t shift) {
+    size_t factor = (size_t)1 << shift;
+    size_t out_count = count >> shift;
+    for (size_t i = 0; i < out_count; i++) {
+        int32_t sum = 0;
+        for (size_t j = 0; j < factor; j++) {
+            sum += src[i * factor + j];
+        }
+        dst[i] = sum >> shift;
+    }
+    return out_count;
+}
+
+static void run_median(int32_t *restrict src, int32_t *restrict dst, size_t count, uint8_t window, int32_t *history) {
+    // The work buffers reserve ADC_FILTER_HISTORY slots in front of the data,
+    // so the previous block's tail sits right before src[0].
+    memcpy(src - ADC_FILTER_HISTORY, history, ADC_FILTER_HISTORY * sizeof(int32_t));
+    if (window == 5) {
+        for (size_t i = 0; i < count; i++) {
+            dst[i] = median5(src[i - 4], src[i - 3], src[i - 2], src[i - 1], src[i]);
+        }
+    } else {
+        for (size_t i = 0; i < count; i++) {
+            dst[i] = median3(src[i - 2], src[i - 1], src[i]);
+        }
+    }
+    memcpy(history, src + count - ADC_FILTER_HISTORY, ADC_FILTER_HISTORY * sizeof(int32_t));
+}
+
+static void run_iir(const int32_t *src, int32_t *dst, size_t count, uint8_t shift, int32_t *state) {
+    // The recursion carries y from sample to sample, so this stage stays
+    // scalar, but the body is a handful of integer ops with no branches.
+    int32_t y = *state;
+    for (size_t i = 0; i < count; i++) {
+        y += ((src[i] << 16) - y) >> shift;
+        dst[i] = y >> 16;
+    }
+    *state = y;
+}
+
+size_t adc_filter_chain_run(adc_filter_chain_t *chain, const adc_cal_table_t *table,
+                            const uint16_t *samples, size_t count, const int32_t **out) {
+    if (count > ADC_FILTER_MAX_BLOCK) {
+        count = ADC_FILTER_MAX_BLOCK;
+    }
+
+    // Fused input stage: mask off channel bits and optionally convert to mV.
+    int32_t *in = chain->work[0] + ADC_FILTER_HISTORY;
+    if (table) {
+        for (size_t i = 0; i < count; i++) {
+            in[i] = table->mv[samples[i] & MASK_12BIT];
+        }
+    } else {
+        for (size_t i = 0; i < count; i++) {
+            in[i] = samples[i] & MASK_12BIT;
+        }
+    }
+
+    // Seed every stage from the first sample so the output does not ramp up from zero.
+    if (!chain->primed && count > 0) {
+        for (uint8_t s = 0; s < chain->num_stages; s++) {
+            for (int h = 0; h < ADC_FILTER_HISTORY; h++) {
+                chain->history[s][h] = in[0];
+            }
+            chain->iir_state[s] = in[0] << 16;
+        }
+        chain->primed = 1;
+    }
+
+    int cur = 0;
+    for (uint8_t s = 0; s < chain->num_stages; s++) {
+        int32_t *src = chain->work[cur] + ADC_FILTER_HISTORY;
+        int32_t *dst = chain->work[cur ^ 1] + ADC_FILTER_HISTORY;
+        const adc_filter_stage_t *stage = &chain->stages[s];
+
+        switch (stage->type) {
+        case ADC_FILTER_DECIMATE:
+            count = run_decimate(src, dst, count, stage->param);
+            break;
+        case ADC_FILTER_MEDIAN:
+            run_median(src, dst, count, stage->param, chain->history[s]);
+            break;
+        case ADC_FILTER_IIR:
+            run_iir(src, dst, count, stage->param, &chain->iir_state[s]);
+            break;
+        }
+        cur ^= 1;
+    }
+
+    *out = chain->work[cur] + ADC_FILTER_HISTORY;
+    return count;
+}
+
+#ifdef ESP_PLATFORM
+
+esp_adc_cal_value_t adc_cal_table_init(adc_cal_table_t *table, adc_unit_t unit, adc_atten_t atten,
+                                       adc_bits_width_t width, uint32_t default_vref) {
+    esp_adc_cal_value_t source = esp_adc_cal_characterize(unit, atten, width, default_vref, &table->chars);
+    table->coeff_a = table->chars.coeff_a;
+    table->coeff_b = table->chars.coeff_b;
+    for (uint32_t raw = 0; raw < ADC_CAL_TABLE_SIZE; raw++) {
+        // Not the linear model: at 11 dB the driver may add its low/high curve correction.
+        table->mv[raw] = esp_adc_cal_raw_to_voltage(raw, &table->chars);
+    }
+    return source;
+}
+
+#endif
@@ -0,0 +1,85 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef ESP_PLATFORM
+#include "esp_adc_cal.h"
+#endif
+
+// Raw-to-millivolt calibration and fixed-point filtering for ADC sample blocks.
+//
+// The calibration curve is evaluated once at startup into a 4096-entry table,
+// so converting a sample is a single masked load instead of a call into
+// esp_adc_cal_raw_to_voltage. The filter chain runs a short list of integer
+// stages over whole blocks; the per-sample loops have no data-dependent
+// branches so the compiler can unroll and vectorize them.
+
+#define ADC_CAL_TABLE_SIZE 4096  // One entry per 12-bit raw code.
+
+typedef struct {
+    uint16_t mv[ADC_CAL_TABLE_SIZE];
+    uint32_t coeff_a;  // Linear model the table was built from.
+    uint32_t coeff_b;
+#ifdef ESP_PLATFORM
+    esp_adc_cal_characteristics_t chars;  // Per table, for callers that still need the per-sample call.
+#endif
+} adc_cal_table_t;
+
+// Build the table from the linear model used by esp_adc_cal:
+// mV = (raw * coeff_a + 32768) / 65536 + coeff_b.
+void adc_cal_table_build_linear(adc_cal_table_t *table, uint32_t coeff_a, uint32_t coeff_b);
+
+// Evaluate the table's linear model for one raw code, the way a per-sample
+// calibration call does. Common/Tools/adc_cal_bench times it against the table.
+uint32_t adc_cal_linear_to_mv(const adc_cal_table_t *table, uint32_t raw);
+
+// Convert one sample word; the channel bits (if any) are masked off.
+static inline uint16_t adc_cal_to_mv(const adc_cal_table_t *table, uint16_t sample) {
+    return table->mv[sample & (ADC_CAL_TABLE_SIZE - 1)];
+}
+
+// Convert a block of sample words to millivolts.
+void adc_cal_apply(const adc_cal_table_t *table, const uint16_t *samples, uint16_t *mv, size_t count);
+
+#define ADC_FILTER_MAX_STAGES 4
+#define ADC_FILTER_MAX_BLOCK 256  // Largest block accepted by adc_filter_chain_run().
+#define ADC_FILTER_HISTORY 4  // Samples of look-back kept between blocks (median of up to 5).
+
+typedef enum {
+    ADC_FILTER_DECIMATE,  // Average groups of 2^param samples (oversampling + decimation).
+    ADC_FILTER_MEDIAN,  // Median of the last param samples, param is 3 or 5 (despiking).
+    ADC_FILTER_IIR,  // One-pole low-pass, y += (x - y) / 2^param.
+} adc_filter_type_t;
+
+typedef struct {
+    adc_filter_type_t type;
+    uint8_t param;
+} adc_filter_stage_t;
+
+typedef struct {
+    adc_filter_stage_t stages[ADC_FILTER_MAX_STAGES];
+    uint8_t num_stages;
+    uint8_t primed;  // Set once history and IIR state have been seeded from real data.
+    int32_t history[ADC_FILTER_MAX_STAGES][ADC_FILTER_HISTORY];
+    int32_t iir_state[ADC_FILTER_MAX_STAGES];  // Q16 accumulator per IIR stage.
+    int32_t work[2][ADC_FILTER_HISTORY + ADC_FILTER_MAX_BLOCK];  // Ping-pong buffers.
+} adc_filter_chain_t;
+
+void adc_filter_chain_init(adc_filter_chain_t *chain, const adc_filter_stage_t *stages, size_t num_stages);
+
+// Run a block through the chain. With a table the samples are converted to
+// millivolts on the way in, without one the raw 12-bit codes are filtered.
+// count must not exceed ADC_FILTER_MAX_BLOCK and should be a multiple of every
+// decimation factor. Returns the number of output values and points *out at
+// them; the output stays valid until the next call.
+size_t adc_filter_chain_run(adc_filter_chain_t *chain, const adc_cal_table_t *table,
+                            const uint16_t *samples, size_t count, const int32_t **out);
+
+#ifdef ESP_PLATFORM
+
+// Characterize the ADC and fill the table by evaluating the calibration once
+// per raw code. Returns the source of the calibration values.
+esp_adc_cal_value_t adc_cal_table_init(adc_cal_table_t *table, adc_unit_t unit, adc_atten_t atten,
+                                       adc_bits_width_t width, uint32_t default_vref);
+#endif
@@ -0,0 +1,245 @@
+#include <string.h>
+#include "adc_sampler.h"
+
+#ifdef ESP_PLATFORM
+#include "esp_timer.h"
+#endif
+
+#define RING_MASK (ADC_SAMPLER_RING_FRAMES - 1)
+
+_Static_assert((ADC_SAMPLER_RING_FRAMES & RING_MASK) == 0, "ADC_SAMPLER_RING_FRAMES must be a power of two");
+
+void adc_sampler_init(adc_sampler_t *sampler, const adc_sample_source_t *source) {
+    memset(sampler, 0, sizeof(*sampler));
+    sampler->source = *source;
+}
+
+bool adc_sampler_start(adc_sampler_t *sampler) {
+    sampler->filling = NULL;
+    return sampler->source.start(sampler->source.ctx);
+}
+
+void adc_sampler_stop(adc_sampler_t *sampler) {
+    sampler->source.stop(sampler->source.ctx);
+}
+
+bool adc_sampler_pump(adc_sampler_t *sampler, uint32_t timeout_ms) {
+    adc_sample_frame_t *frame = sampler->filling;
+
+    // Pick the destination once per frame so a half-filled frame never moves.
+    if (frame == NULL) {
+        uint32_t tail = __atomic_load_n(&sampler->tail, __ATOMIC_ACQUIRE);
+        bool full = (sampler->head - tail) >= ADC_SAMPLER_RING_FRAMES;
+        frame = full ? &sampler->scratch : &sampler->frames[sampler->head & RING_MASK];
+        frame->count = 0;
+        sampler->filling = frame;
+    }
+
+    size_t got = sampler->source.read(sampler->source.ctx, &frame->samples[frame->count],
+                                      ADC_SAMPLER_FRAME_SAMPLES - frame->count, timeout_ms);
+    frame->count += got;
+    sampler->stats.samples += got;
+    if (frame->count < ADC_SAMPLER_FRAME_SAMPLES) {
+        return false;
+    }
+
+    sampler->filling = NULL;
+    if (frame == &sampler->scratch) {
+        sampler->stats.dropped_frames++;
+        return false;
+    }
+
+    frame->seq = sampler->head;
+    frame->timestamp_us = sampler->source.now_us(sampler->source.ctx);
+    sampler->stats.frames++;
+    __atomic_store_n(&sampler->head, sampler->head + 1, __ATOMIC_RELEASE);
+    return true;
+}
+
+const adc_sample_frame_t *adc_sampler_acquire(adc_sampler_t *sampler) {
+    uint32_t head = __atomic_load_n(&sampler->head, __ATOMIC_ACQUIRE);
+    if (head == sampler->tail) {
+        return NULL;
+    }
+    return &sampler->frames[sampler->tail & RING_MASK];
+}
+
+void adc_sampler_release(adc_sampler_t *sampler) {
+    __atomic_store_n(&sampler->tail, sampler->tail + 1, __ATOMIC_RELEASE);
+}
+
+// ---------------------------------------------------------------------------
+// Simulated signal generator
+// ---------------------------------------------------------------------------
+
+static bool sim_start(void *ctx) {
+    (void)ctx;
+    return true;
+}
+
+static size_t sim_read(void *ctx, uint16_t *dst, size_t max_samples, uint32_t timeout_ms) {
+    adc_sim_source_t *sim = ctx;
+    (void)timeout_ms;  // Samples are always ready.
+    uint32_t half = sim->period_samples / 2;
+
+    for (size_t i = 0; i < max_samples; i++) {
+        // Triangle sweep 0 -> 4095 -> 0 over one period.
+        uint32_t pos = sim->position;
+        uint32_t ramp = pos < half ? pos : sim->period_samples - pos;
+        int32_t value = (int32_t)((ramp * 4095u) / half);
+
+        // Cheap LCG noise centred on zero.
+        sim->lcg = sim->lcg * 1664525u + 1013904223u;
+        if (sim->noise_lsb) {
+            value += (int32_t)((sim->lcg >> 16) % (sim->noise_lsb + 1u)) - sim->noise_lsb / 2;
+        }
+        value = value < 0 ? 0 : (value > 4095 ? 4095 : value);
+
+        dst[i] = ADC_SAMPLE_MAKE(sim->pattern[sim->pattern_pos], value);
+        sim->position = (pos + 1 == sim->period_samples) ? 0 : pos + 1;
+        sim->pattern_pos = (sim->pattern_pos + 1 == sim->pattern_len) ? 0 : sim->pattern_pos + 1;
+    }
+    sim->generated += max_samples;
+    return max_samples;
+}
+
+static void sim_stop(void *ctx) {
+    (void)ctx;
+}
+
+static int64_t sim_now_us(void *ctx) {
+    adc_sim_source_t *sim = ctx;
+    return (int64_t)(sim->generated * 1000000u / sim->sample_rate_hz);
+}
+
+void adc_sim_source_init(adc_sim_source_t *sim, uint8_t channel, uint32_t sample_rate_hz) {
+    memset(sim, 0, sizeof(*sim));
+    sim->pattern[0] = channel;
+    sim->pattern_len = 1;
+    sim->sample_rate_hz = sample_rate_hz;
+    sim->period_samples = sample_rate_hz;  // One full sweep per simulated second.
+    sim->noise_lsb = 16;
+    sim->lcg = 1;
+}
+
+void adc_sim_source_set_pattern(adc_sim_source_t *sim, const adc_pattern_entry_t *pattern, uint8_t pattern_len) {
+    if (pattern_len == 0 || pattern_len > ADC_SAMPLER_MAX_PATTERN) {
+        return;
+    }
+    for (uint8_t i = 0; i < pattern_len; i++) {
+        sim->pattern[i] = pattern[i].channel;
+    }
+    sim->pattern_len = pattern_len;
+    sim->pattern_pos = 0;
+}
+
+adc_sample_source_t adc_sim_source(adc_sim_source_t *sim) {
+    adc_sample_source_t source = {
+        .start = sim_start,
+        .read = sim_read,
+        .stop = sim_stop,
+        .now_us = sim_now_us,
+        .ctx = sim,
+    };
+    return source;
+}
+
+// ---------------------------------------------------------------------------
+// DMA source (ESP32 only)
+// ---------------------------------------------------------------------------
+
+#ifdef ESP_PLATFORM
+
+static bool dma_start(void *ctx) {
+    adc_dma_source_t *dma = ctx;
+    adc_digi_pattern_config_t pattern[ADC_SAMPLER_MAX_PATTERN];
+    uint32_t chan_mask = 0;
+
+    for (uint8_t i = 0; i < dma->pattern_len; i++) {
+        pattern[i] = (adc_digi_pattern_config_t){
+            .atten = dma->pattern[i].atten,
+            .channel = dma->pattern[i].channel,
+            .unit = 0,  // ADC1
+            .bit_width = SOC_ADC_DIGI_MAX_BITWIDTH,
+        };
+        chan_mask |= 1 << dma->pattern[i].channel;
+    }
+
+    adc_digi_init_config_t init_config = {
+        .max_store_buf_size = ADC_SAMPLER_RING_FRAMES * ADC_SAMPLER_FRAME_SAMPLES * sizeof(uint16_t),
+        .conv_num_each_intr = ADC_SAMPLER_FRAME_SAMPLES * sizeof(uint16_t),
+        .adc1_chan_mask = chan_mask,
+        .adc2_chan_mask = 0,
+    };
+    if (adc_digi_initialize(&init_config) != ESP_OK) {
+        return false;
+    }
+
+    adc_digi_configuration_t digi_config = {
+        .conv_limit_en = 1,
+        .conv_limit_num = 250,
+        .pattern_num = dma->pattern_len,
+        .adc_pattern = pattern,
+        .sample_freq_hz = dma->sample_rate_hz,
+        .conv_mode = ADC_CONV_SINGLE_UNIT_1,
+        .format = ADC_DIGI_OUTPUT_FORMAT_TYPE1,
+    };
+    if (adc_digi_controller_configure(&digi_config) != ESP_OK) {
+        adc_digi_deinitialize();
+        return false;
+    }
+    return adc_digi_start() == ESP_OK;
+}
+
+static size_t dma_read(void *ctx, uint16_t *dst, size_t max_samples, uint32_t timeout_ms) {
+    adc_dma_source_t *dma = ctx;
+    uint32_t out_bytes = 0;
+
+    // Type 1 output words already have the sample layout, so the driver copies
+    // straight into the frame without a conversion pass.
+    esp_err_t ret = adc_digi_read_bytes((uint8_t *)dst, max_samples * sizeof(uint16_t), &out_bytes, timeout_ms);
+    if (ret == ESP_ERR_INVALID_STATE) {
+        dma->overruns++;  // The driver buffer overflowed, but the bytes returned are still valid.
+    } else if (ret != ESP_OK) {
+        return 0;
+    }
+    return out_bytes / sizeof(uint16_t);
+}
+
+static void dma_stop(void *ctx) {
+    adc_digi_stop();
+    adc_digi_deinitialize();
+}
+
+static int64_t dma_now_us(void *ctx) {
+    return esp_timer_get_time();
+}
+
+void adc_dma_source_init(adc_dma_source_t *dma, adc1_channel_t channel, adc_atten_t atten, uint32_t sample_rate_hz) {
+    adc_pattern_entry_t entry = { .channel = channel, .atten = atten };
+    adc_dma_source_init_pattern(dma, &entry, 1, sample_rate_hz);
+}
+
+void adc_dma_source_init_pattern(adc_dma_source_t *dma, const adc_pattern_entry_t *pattern, uint8_t pattern_len,
+                                 uint32_t sample_rate_hz) {
+    memset(dma, 0, sizeof(*dma));
+    if (pattern_len > ADC_SAMPLER_MAX_PATTERN) {
+        pattern_len = ADC_SAMPLER_MAX_PATTERN;
+    }
+    memcpy(dma->pattern, pattern, pattern_len * sizeof(*pattern));
+    dma->pattern_len = pattern_len;
+    dma->sample_rate_hz = sample_rate_hz;
+}
+
+adc_sample_source_t adc_dma_source(adc_dma_source_t *dma) {
+    adc_sample_source_t source = {
+        .start = dma_start,
+        .read = dma_read,
+        .stop = dma_stop,
+        .now_us = dma_now_us,
+        .ctx = dma,
+    };
+    return source;
+}
+
+#endif
@@ -0,0 +1,111 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// Continuous ADC sampling engine.
+//
+// A sample source (the DMA controller on the ESP32, or a simulated signal
+// generator on a Linux host) fills fixed-size frames in a small ring. The
+// producer publishes whole frames and the consumer works on whole blocks, so
+// nobody touches the CPU once per conversion.
+
+// Every sample is a 16-bit word in the ESP32 DMA "type 1" layout:
+// bits 0-11 hold the conversion result, bits 12-15 the ADC1 channel number.
+#define ADC_SAMPLE_DATA(word) ((word) & 0x0FFF)
+#define ADC_SAMPLE_CHANNEL(word) ((word) >> 12)
+#define ADC_SAMPLE_MAKE(channel, data) ((uint16_t)(((channel) << 12) | ((data) & 0x0FFF)))
+
+#define ADC_SAMPLER_FRAME_SAMPLES 256  // Samples per frame (one block for the consumer).
+#define ADC_SAMPLER_RING_FRAMES 8  // Frames in the ring, must be a power of two.
+#define ADC_SAMPLER_MAX_PATTERN 16  // Entries in the ESP32 digital controller pattern table.
+
+// One entry of a scan pattern: the conversions cycle through the entries in order.
+typedef struct {
+    uint8_t channel;  // ADC1 channel number.
+    uint8_t atten;  // Attenuation (adc_atten_t value).
+} adc_pattern_entry_t;
+
+// One block of samples as handed to the consumer.
+typedef struct {
+    uint32_t seq;  // Frame sequence number, increments by one per published frame.
+    int64_t timestamp_us;  // Time the last sample of the frame was collected.
+    uint16_t count;  // Number of valid samples in the frame.
+    uint16_t samples[ADC_SAMPLER_FRAME_SAMPLES];
+} adc_sample_frame_t;
+
+// Where samples come from. read() copies up to max_samples words into dst and
+// returns how many were written, 0 on timeout.
+typedef struct {
+    bool (*start)(void *ctx);
+    size_t (*read)(void *ctx, uint16_t *dst, size_t max_samples, uint32_t timeout_ms);
+    void (*stop)(void *ctx);
+    int64_t (*now_us)(void *ctx);
+    void *ctx;
+} adc_sample_source_t;
+
+typedef struct {
+    uint64_t samples;  // Samples collected from the source.
+    uint32_t frames;  // Frames published to the consumer.
+    uint32_t dropped_frames;  // Frames discarded because the consumer fell behind.
+} adc_sampler_stats_t;
+
+typedef struct {
+    adc_sample_source_t source;
+    adc_sample_frame_t frames[ADC_SAMPLER_RING_FRAMES];
+    adc_sample_frame_t scratch;  // Absorbs samples while the ring is full.
+    adc_sample_frame_t *filling;  // Frame currently being filled, NULL between frames.
+    uint32_t head;  // Frames published, written by the producer only.
+    uint32_t tail;  // Frames released, written by the consumer only.
+    adc_sampler_stats_t stats;
+} adc_sampler_t;
+
+void adc_sampler_init(adc_sampler_t *sampler, const adc_sample_source_t *source);
+bool adc_sampler_start(adc_sampler_t *sampler);
+void adc_sampler_stop(adc_sampler_t *sampler);
+
+// Producer side: read from the source into the current frame. Returns true
+// when a frame was completed and published.
+bool adc_sampler_pump(adc_sampler_t *sampler, uint32_t timeout_ms);
+
+// Consumer side: the oldest published frame, or NULL if none is ready. The
+// frame stays valid until adc_sampler_release() is called.
+const adc_sample_frame_t *adc_sampler_acquire(adc_sampler_t *sampler);
+void adc_sampler_release(adc_sampler_t *sampler);
+
+// Simulated signal generator: a triangle sweep across the full 12-bit range
+// with pseudo-random noise. Samples are tagged by cycling through the channel
+// pattern, like the digital controller does.
+typedef struct {
+    uint8_t pattern[ADC_SAMPLER_MAX_PATTERN];  // Channel number per pattern entry.
+    uint8_t pattern_len;
+    uint8_t pattern_pos;
+    uint32_t sample_rate_hz;  // Only used to advance the simulated clock.
+    uint32_t period_samples;  // Samples per triangle period.
+    uint16_t noise_lsb;  // Peak-to-peak noise amplitude in LSB.
+    uint32_t position;
+    uint32_t lcg;
+    uint64_t generated;
+} adc_sim_source_t;
+
+void adc_sim_source_init(adc_sim_source_t *sim, uint8_t channel, uint32_t sample_rate_hz);
+void adc_sim_source_set_pattern(adc_sim_source_t *sim, const adc_pattern_entry_t *pattern, uint8_t pattern_len);
+adc_sample_source_t adc_sim_source(adc_sim_source_t *sim);
+
+#ifdef ESP_PLATFORM
+#include "driver/adc.h"
+
+// DMA-backed source built on the ADC digital controller.
+typedef struct {
+    adc_pattern_entry_t pattern[ADC_SAMPLER_MAX_PATTERN];
+    uint8_t pattern_len;
+    uint32_t sample_rate_hz;  // Total conversions per second across the whole pattern.
+    uint32_t overruns;
+} adc_dma_source_t;
+
+void adc_dma_source_init(adc_dma_source_t *dma, adc1_channel_t channel, adc_atten_t atten, uint32_t sample_rate_hz);
+void adc_dma_source_init_pattern(adc_dma_source_t *dma, const adc_pattern_entry_t *pattern, uint8_t pattern_len,
+                                 uint32_t sample_rate_hz);
+adc_sample_source_t adc_dma_source(adc_dma_source_t *dma);
+#endif
@@ -0,0 +1,144 @@
+#include <string.h>
+#include "adc_scan.h"
+
+// Beyond this many rounds some channel needs more than ADC_SAMPLER_MAX_PATTERN
+// entries (each takes at least rounds / ADC_SCAN_MAX_RATE_DIV), so stop early.
+#define MAX_HARDWARE_ROUNDS (ADC_SAMPLER_MAX_PATTERN * ADC_SCAN_MAX_RATE_DIV)
+
+static uint32_t gcd(uint32_t a, uint32_t b) {
+    while (b) {
+        uint32_t t = a % b;
+        a = b;
+        b = t;
+    }
+    return a;
+}
+
+bool adc_scan_init(adc_scan_t *scan, const adc_scan_channel_t *channels, uint8_t num_channels, uint32_t sample_rate_hz) {
+    memset(scan, 0, sizeof(*scan));
+    memset(scan->slot_of_channel, -1, sizeof(scan->slot_of_channel));
+    if (num_channels == 0 || num_channels > ADC_SCAN_MAX_CHANNELS || sample_rate_hz == 0) {
+        return false;
+    }
+    scan->sample_rate_hz = sample_rate_hz;
+    scan->sample_period_ns = 1000000000u / sample_rate_hz;
+
+    // Scan rounds per pattern cycle: the least common multiple of the dividers,
+    // so every channel's share of the pattern is exactly 1 / rate_div.
+    uint32_t rounds = 1;
+    for (uint8_t slot = 0; slot < num_channels; slot++) {
+        adc_scan_channel_t ch = channels[slot];
+        if (ch.channel >= 16 || scan->slot_of_channel[ch.channel] >= 0) {
+            return false;
+        }
+        ch.rate_div = ch.rate_div == 0 ? 1 : (ch.rate_div > ADC_SCAN_MAX_RATE_DIV ? ADC_SCAN_MAX_RATE_DIV : ch.rate_div);
+        scan->channels[slot] = ch;
+        scan->slot_of_channel[ch.channel] = slot;
+        scan->soft_div[slot] = 1;
+        if (rounds <= MAX_HARDWARE_ROUNDS) {
+            rounds = rounds / gcd(rounds, ch.rate_div) * ch.rate_div;
+        }
+    }
+    scan->num_channels = num_channels;
+
+    // Count the pattern entries a hardware-only schedule would need.
+    uint32_t needed = ADC_SAMPLER_MAX_PATTERN + 1;
+    if (rounds <= MAX_HARDWARE_ROUNDS) {
+        needed = 0;
+        for (uint8_t slot = 0; slot < num_channels; slot++) {
+            needed += rounds / scan->channels[slot].rate_div;
+        }
+    }
+
+    if (needed <= ADC_SAMPLER_MAX_PATTERN) {
+        // Round-major order spreads each channel's conversions evenly in time.
+        for (uint32_t round = 0; round < rounds; round++) {
+            for (uint8_t slot = 0; slot < num_channels; slot++) {
+                if (round % scan->channels[slot].rate_div == 0) {
+                    scan->pattern[scan->pattern_len].channel = scan->channels[slot].channel;
+                    scan->pattern[scan->pattern_len].atten = scan->channels[slot].atten;
+                    scan->pattern_len++;
+                    scan->entries[slot]++;
+                }
+            }
+        }
+    } else {
+        // The table is too short: scan every channel each round and drop the
+        // extra samples in software instead.
+        for (uint8_t slot = 0; slot < num_channels; slot++) {
+            scan->pattern[slot].channel = scan->channels[slot].channel;
+            scan->pattern[slot].atten = scan->channels[slot].atten;
+            scan->entries[slot] = 1;
+            scan->soft_div[slot] = scan->channels[slot].rate_div;
+        }
+        scan->pattern_len = num_channels;
+    }
+    return true;
+}
+
+uint32_t adc_scan_channel_rate(const adc_scan_t *scan, uint8_t slot) {
+    return (uint32_t)((uint64_t)scan->sample_rate_hz * scan->entries[slot] / scan->pattern_len / scan->soft_div[slot]);
+}
+
+uint32_t adc_scan_demux(adc_scan_t *scan, const uint16_t *samples, size_t count, int64_t timestamp_us) {
+    uint32_t completed = 0;
+
+    for (size_t i = 0; i < count; i++) {
+        int8_t slot = scan->slot_of_channel[ADC_SAMPLE_CHANNEL(samples[i])];
+        if (slot < 0) {
+            continue;
+        }
+        if (scan->soft_div[slot] > 1) {
+            uint8_t phase = scan->soft_phase[slot];
+            scan->soft_phase[slot] = phase + 1 == scan->soft_div[slot] ? 0 : phase + 1;
+            if (phase != 0) {
+                continue;
+            }
+        }
+
+        scan->buffers[slot][scan->active[slot]][scan->fill[slot]++] = ADC_SAMPLE_DATA(samples[i]);
+        scan->stats[slot].samples++;
+        if (scan->fill[slot] < ADC_SCAN_BLOCK) {
+            continue;
+        }
+
+        // Block complete: stamp it with its last sample's time, counted back
+        // from the end of this frame at the conversion rate.
+        adc_scan_channel_stats_t *stats = &scan->stats[slot];
+        int64_t block_us = timestamp_us - (int64_t)((uint64_t)(count - 1 - i) * scan->sample_period_ns / 1000);
+        if (stats->blocks > 0) {
+            int64_t interval = block_us - stats->block_us;
+            if (stats->blocks == 1 || interval < stats->interval_min_us) {
+                stats->interval_min_us = interval;
+            }
+            if (interval > stats->interval_max_us) {
+                stats->interval_max_us = interval;
+            }
+        }
+        stats->block_us = block_us;
+        stats->blocks++;
+
+        // If the consumer still holds the other half, drop this block rather
+        // than overwrite the one being processed.
+        uint32_t bit = 1u << slot;
+        scan->fill[slot] = 0;
+        if (__atomic_load_n(&scan->ready, __ATOMIC_ACQUIRE) & bit) {
+            scan->stats[slot].overruns++;
+            continue;
+        }
+        scan->active[slot] ^= 1;
+        scan->ready_us[slot] = block_us;
+        __atomic_fetch_or(&scan->ready, bit, __ATOMIC_RELEASE);
+        completed |= bit;
+    }
+    return completed;
+}
+
+void adc_scan_block_done(adc_scan_t *scan, uint8_t slot, int64_t now_us) {
+    adc_scan_channel_stats_t *stats = &scan->stats[slot];
+    int64_t latency = now_us - scan->ready_us[slot];
+    if (latency > stats->latency_max_us) {
+        stats->latency_max_us = latency;
+    }
+    __atomic_fetch_and(&scan->ready, ~(1u << slot), __ATOMIC_RELEASE);
+}
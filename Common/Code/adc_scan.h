@@ -0,0 +1,90 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "adc_sampler.h"
+
+// Multi-channel ADC scan scheduler.
+//
+// Each configured ADC1 channel has its own attenuation and rate divider. The
+// scheduler turns the list into a digital controller pattern table (so slow
+// channels simply appear in fewer pattern entries), then demultiplexes the
+// interleaved DMA stream into contiguous per-channel (struct-of-arrays)
+// buffers. Every channel is double-buffered: the acquisition side fills one
+// half while the consumer works on the other.
+//
+// Block timing is taken on the acquisition side: each block is stamped with
+// the time of its last sample, interpolated back from the timestamp of the
+// DMA frame it arrived in. The spread of those intervals is the sampling
+// jitter. The consumer's delay in picking a block up is kept separately.
+
+#define ADC_SCAN_MAX_CHANNELS 8  // ADC1 has eight channels.
+// Samples per channel per block. A channel gets at most one frame's worth of
+// samples per frame, so it never completes two blocks in one demux call, which
+// the consumer could not release in between.
+#define ADC_SCAN_BLOCK ADC_SAMPLER_FRAME_SAMPLES
+#define ADC_SCAN_MAX_RATE_DIV 16
+
+typedef struct {
+    uint8_t channel;  // ADC1 channel number.
+    uint8_t atten;  // Attenuation (adc_atten_t value).
+    uint8_t rate_div;  // Sample on every rate_div-th scan round; 1 is the full scan rate.
+} adc_scan_channel_t;
+
+typedef struct {
+    uint32_t samples;  // Samples stored for this channel.
+    uint32_t blocks;  // Blocks completed, including those lost to overruns.
+    uint32_t overruns;  // Blocks discarded because the previous one was still being consumed.
+    int64_t block_us;  // Time of the last sample of the newest completed block.
+    int64_t interval_min_us;  // Shortest and longest time between completed blocks;
+    int64_t interval_max_us;  // their spread is the sampling jitter.
+    int64_t latency_max_us;  // Longest time from block completion to adc_scan_block_done.
+} adc_scan_channel_stats_t;
+
+typedef struct {
+    uint8_t num_channels;
+    uint32_t sample_rate_hz;  // Total conversion rate across the pattern.
+    uint32_t sample_period_ns;
+    adc_scan_channel_t channels[ADC_SCAN_MAX_CHANNELS];
+    int8_t slot_of_channel[16];  // ADC channel number -> slot, -1 when not scanned.
+
+    adc_pattern_entry_t pattern[ADC_SAMPLER_MAX_PATTERN];  // Pattern table for the digital controller.
+    uint8_t pattern_len;
+    uint8_t entries[ADC_SCAN_MAX_CHANNELS];  // Pattern entries per slot.
+    uint8_t soft_div[ADC_SCAN_MAX_CHANNELS];  // Software decimation when the pattern table is too short.
+    uint8_t soft_phase[ADC_SCAN_MAX_CHANNELS];
+
+    uint16_t buffers[ADC_SCAN_MAX_CHANNELS][2][ADC_SCAN_BLOCK];
+    uint16_t fill[ADC_SCAN_MAX_CHANNELS];
+    uint8_t active[ADC_SCAN_MAX_CHANNELS];  // Half currently being filled.
+    uint32_t ready;  // Bit per slot with a completed block waiting for the consumer.
+    int64_t ready_us[ADC_SCAN_MAX_CHANNELS];  // Completion time of the block waiting in each slot.
+
+    adc_scan_channel_stats_t stats[ADC_SCAN_MAX_CHANNELS];
+} adc_scan_t;
+
+// Validate the channel list and build the pattern table for a total conversion
+// rate. Returns false for an empty list, too many channels, or a channel
+// listed twice.
+bool adc_scan_init(adc_scan_t *scan, const adc_scan_channel_t *channels, uint8_t num_channels, uint32_t sample_rate_hz);
+
+// Per-channel sample rate the pattern delivers.
+uint32_t adc_scan_channel_rate(const adc_scan_t *scan, uint8_t slot);
+
+// Acquisition side: sort a block of interleaved samples into the per-channel
+// buffers. timestamp_us is the time of the last sample (the frame timestamp).
+// Returns the bits of slots that completed a block during this call.
+uint32_t adc_scan_demux(adc_scan_t *scan, const uint16_t *samples, size_t count, int64_t timestamp_us);
+
+// Consumer side: slots with a completed block, the block itself, and the call
+// that hands the buffer back once processing is finished.
+static inline uint32_t adc_scan_ready(const adc_scan_t *scan) {
+    return __atomic_load_n(&scan->ready, __ATOMIC_ACQUIRE);
+}
+
+static inline const uint16_t *adc_scan_block(const adc_scan_t *scan, uint8_t slot) {
+    return scan->buffers[slot][scan->active[slot] ^ 1];
+}
+
+void adc_scan_block_done(adc_scan_t *scan, uint8_t slot, int64_t now_us);
@@ -0,0 +1,82 @@
+#include <string.h>
+#include "isr_queue.h"
+
+#ifdef ESP_PLATFORM
+#include <stdio.h>
+#include "esp_log.h"
+#endif
+
+_Static_assert((ISR_QUEUE_CAPACITY & (ISR_QUEUE_CAPACITY - 1)) == 0, "ISR_QUEUE_CAPACITY must be a power of two");
+
+void isr_queue_init(isr_queue_t *queue) {
+    memset(queue, 0, sizeof(*queue));
+}
+
+static inline uint8_t latency_bucket(int64_t latency_us) {
+    if (latency_us <= 0) {
+        return 0;
+    }
+    uint8_t bucket = 64 - __builtin_clzll((uint64_t)latency_us);
+    return bucket < ISR_QUEUE_HIST_BUCKETS ? bucket : ISR_QUEUE_HIST_BUCKETS - 1;
+}
+
+bool isr_queue_pop(isr_queue_t *queue, isr_event_t *event, int64_t now_us) {
+    uint32_t tail = queue->tail;
+    uint32_t head = __atomic_load_n(&queue->head, __ATOMIC_ACQUIRE);
+    if (head == tail) {
+        return false;
+    }
+    *event = queue->events[tail & (ISR_QUEUE_CAPACITY - 1)];
+    __atomic_store_n(&queue->tail, tail + 1, __ATOMIC_RELEASE);
+
+    int64_t latency = now_us - event->timestamp_us;
+    queue->stats.popped++;
+    queue->stats.latency_hist[latency_bucket(latency)]++;
+    if (latency > queue->stats.latency_max_us) {
+        queue->stats.latency_max_us = latency;
+    }
+    return true;
+}
+
+void isr_queue_wakeup(isr_queue_t *queue) {
+    queue->stats.wakeups++;
+    queue->stats.overflows = __atomic_load_n(&queue->overflows, __ATOMIC_RELAXED);
+    queue->stats.pushed = __atomic_load_n(&queue->head, __ATOMIC_ACQUIRE);
+}
+
+int64_t isr_queue_latency_percentile(const isr_queue_t *queue, float fraction) {
+    uint32_t target = (uint32_t)(queue->stats.popped * fraction);
+    uint32_t seen = 0;
+    for (uint8_t bucket = 0; bucket < ISR_QUEUE_HIST_BUCKETS; bucket++) {
+        seen += queue->stats.latency_hist[bucket];
+        if (seen > target || seen == queue->stats.popped) {
+            return bucket == ISR_QUEUE_HIST_BUCKETS - 1 ? queue->stats.latency_max_us : (int64_t)1 << bucket;
+        }
+    }
+    return queue->stats.latency_max_us;
+}
+
+#ifdef ESP_PLATFORM
+
+void isr_queue_log_stats(const isr_queue_t *queue, const char *tag) {
+    const isr_queue_stats_t *stats = &queue->stats;
+    ESP_LOGI(tag, "ISR queue: %lu pushed, %lu popped, %lu overflows, %lu wakeups, latency p50 < %lld us, p99 < %lld us, max %lld us",
+             stats->pushed, stats->popped, stats->overflows, stats->wakeups,
+             isr_queue_latency_percentile(queue, 0.5f), isr_queue_latency_percentile(queue, 0.99f),
+             stats->latency_max_us);
+
+    char line[ISR_QUEUE_HIST_BUCKETS * 12];
+    size_t len = 0;
+    for (uint8_t bucket = 0; bucket < ISR_QUEUE_HIST_BUCKETS && len < sizeof(line); bucket++) {
+        if (stats->latency_hist[bucket] == 0) {
+            continue;
+        }
+        bool last = bucket == ISR_QUEUE_HIST_BUCKETS - 1;
+        len += snprintf(&line[len], sizeof(line) - len, " %s%lu:%lu", last ? ">=" : "<",
+                        1ul << (last ? bucket - 1 : bucket), stats->latency_hist[bucket]);
+    }
+    line[len < sizeof(line) ? len : sizeof(line) - 1] = '\0';
+    ESP_LOGI(tag, "Latency histogram (us):%s", line);
+}
+
+#endif
@@ -0,0 +1,103 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef ESP_PLATFORM
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "esp_timer.h"
+#endif
+
+// Lock-free event queue from an interrupt handler to one task.
+//
+// A single producer (the ISR) and a single consumer (the task) share a ring of
+// small events indexed by free-running head/tail counters, so neither side
+// ever takes a lock or disables interrupts. The ISR only records what happened
+// and when; slow work such as ADC conversions belongs in the task. When the
+// ring is full the newest event is dropped and counted.
+//
+// Every event carries the time it was pushed. The consumer passes its own
+// wake-up time to isr_queue_pop(), which files the difference into a
+// power-of-two latency histogram.
+
+#define ISR_QUEUE_CAPACITY 32  // Events in the ring, must be a power of two.
+#define ISR_QUEUE_HIST_BUCKETS 16  // Bucket 0 is < 1 us, bucket n is [2^(n-1), 2^n) us, the last is open ended.
+
+typedef struct {
+    int64_t timestamp_us;  // When the ISR pushed the event.
+    uint32_t value;  // Event payload, e.g. a GPIO number or level.
+} isr_event_t;
+
+typedef struct {
+    uint32_t pushed;  // Events accepted by the ring.
+    uint32_t popped;  // Events delivered to the consumer.
+    uint32_t overflows;  // Events dropped because the ring was full.
+    uint32_t wakeups;  // Times the consumer drained the ring.
+    int64_t latency_max_us;
+    uint32_t latency_hist[ISR_QUEUE_HIST_BUCKETS];
+} isr_queue_stats_t;
+
+typedef struct {
+    isr_event_t events[ISR_QUEUE_CAPACITY];
+    uint32_t head;  // Events pushed, written by the producer only.
+    uint32_t tail;  // Events popped, written by the consumer only.
+    uint32_t overflows;  // Written by the producer only.
+    isr_queue_stats_t stats;  // Consumer-side counters.
+} isr_queue_t;
+
+void isr_queue_init(isr_queue_t *queue);
+
+// Producer side. Forced inline so an IRAM interrupt handler never calls an
+// out-of-line copy the compiler might have placed in flash.
+// Returns false if the ring was full and the event was dropped.
+static inline __attribute__((always_inline)) bool isr_queue_push(isr_queue_t *queue, uint32_t value, int64_t timestamp_us) {
+    uint32_t head = queue->head;
+    uint32_t tail = __atomic_load_n(&queue->tail, __ATOMIC_ACQUIRE);
+    if (head - tail >= ISR_QUEUE_CAPACITY) {
+        __atomic_store_n(&queue->overflows, queue->overflows + 1, __ATOMIC_RELAXED);
+        return false;
+    }
+    isr_event_t *event = &queue->events[head & (ISR_QUEUE_CAPACITY - 1)];
+    event->timestamp_us = timestamp_us;
+    event->value = value;
+    __atomic_store_n(&queue->head, head + 1, __ATOMIC_RELEASE);
+    return true;
+}
+
+// Consumer side: take the oldest event and record its latency against now_us.
+// Returns false when the ring is empty.
+bool isr_queue_pop(isr_queue_t *queue, isr_event_t *event, int64_t now_us);
+
+// Consumer side: events waiting in the ring.
+static inline uint32_t isr_queue_pending(const isr_queue_t *queue) {
+    return __atomic_load_n(&queue->head, __ATOMIC_ACQUIRE) - queue->tail;
+}
+
+// Consumer side: call once per wake-up, before draining, so the stats also
+// count wake-ups and pick up the producer's overflow counter.
+void isr_queue_wakeup(isr_queue_t *queue);
+
+// Latency in microseconds below which the given fraction (0..1) of the popped
+// events fell, taken from the histogram bucket bounds.
+int64_t isr_queue_latency_percentile(const isr_queue_t *queue, float fraction);
+
+#ifdef ESP_PLATFORM
+
+// Push from an ISR and wake the consumer task through its notification value,
+// which is lighter than a semaphore or a FreeRTOS queue. The task waits with
+// ulTaskNotifyTake() and then drains the ring with isr_queue_pop(). Forced
+// inline for the same reason as isr_queue_push().
+static inline __attribute__((always_inline)) bool isr_queue_push_and_notify(isr_queue_t *queue, TaskHandle_t consumer, uint32_t value) {
+    bool pushed = isr_queue_push(queue, value, esp_timer_get_time());
+    BaseType_t woken = pdFALSE;
+    vTaskNotifyGiveFromISR(consumer, &woken);
+    portYIELD_FROM_ISR(woken);
+    return pushed;
+}
+
+// Log event counts, overflows and the latency histogram.
+void isr_queue_log_stats(const isr_queue_t *queue, const char *tag);
+
+#endif
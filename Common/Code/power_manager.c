@@ -0,0 +1,325 @@
+#include <string.h>
+#include "power_manager.h"
+
+const pm_state_info_t pm_esp32_states[PM_STATE_COUNT] = {
+    [PM_STATE_ACTIVE] = {
+        .power_uw = 66000,  // ~20 mA, CPU idling at 80 MHz with the radio off.
+        .wake_sources = PM_WAKE_TIMER | PM_WAKE_EXT0 | PM_WAKE_ADC_THRESHOLD,
+    },
+    [PM_STATE_LIGHT_SLEEP] = {
+        .power_uw = 2640,  // ~0.8 mA.
+        .entry_us = 100,
+        .exit_us = 1000,
+        .wake_sources = PM_WAKE_TIMER | PM_WAKE_EXT0,
+    },
+    [PM_STATE_DEEP_SLEEP] = {
+        .power_uw = 33,  // ~10 uA with the RTC timer and RTC memory powered.
+        .entry_us = 1000,
+        .exit_us = 200000,  // ROM, bootloader and app start-up.
+        .wake_sources = PM_WAKE_TIMER | PM_WAKE_EXT0,
+    },
+};
+
+void pm_init(pm_t *pm, const pm_backend_t *backend, const pm_state_info_t *states) {
+    memset(pm, 0, sizeof(*pm));
+    memcpy(pm->states, states ? states : pm_esp32_states, sizeof(pm->states));
+    pm->backend = *backend;
+}
+
+int pm_register(pm_t *pm, const char *name, uint8_t wake_sources, uint32_t max_latency_us, pm_state_t max_state) {
+    if (pm->num_clients >= PM_MAX_CLIENTS) {
+        return -1;
+    }
+    pm_client_t *client = &pm->clients[pm->num_clients];
+    client->name = name;
+    client->deadline_us = PM_NO_DEADLINE;
+    client->wake_sources = wake_sources & ~PM_WAKE_TIMER;
+    client->max_latency_us = max_latency_us;
+    client->max_state = max_state;
+    return pm->num_clients++;
+}
+
+void pm_set_deadline(pm_t *pm, int client, int64_t deadline_us) {
+    if (client >= 0 && client < pm->num_clients) {
+        pm->clients[client].deadline_us = deadline_us;
+    }
+}
+
+static inline uint64_t energy_nj(uint32_t power_uw, int64_t time_us) {
+    return time_us > 0 ? (uint64_t)time_us * power_uw / 1000 : 0;
+}
+
+pm_decision_t pm_decide(const pm_t *pm, int64_t now_us) {
+    pm_decision_t best = { .state = PM_STATE_ACTIVE, .wake_at_us = PM_NO_DEADLINE, .limiting_client = -1 };
+    uint64_t best_energy = UINT64_MAX;
+    bool found = false;
+
+    // Deepest first, so a tie (or an open-ended sleep) goes to the deeper state.
+    for (int state = PM_STATE_COUNT - 1; state >= PM_STATE_LIGHT_SLEEP; state--) {
+        const pm_state_info_t *info = &pm->states[state];
+        int64_t deadline = PM_NO_DEADLINE;
+        int8_t limiting = -1;
+        uint8_t armed = 0;
+        bool allowed = true;
+
+        for (uint8_t i = 0; i < pm->num_clients && allowed; i++) {
+            const pm_client_t *client = &pm->clients[i];
+            int64_t due = client->deadline_us;
+            if (due != PM_NO_DEADLINE && (int)client->max_state < state) {
+                allowed = false;  // Busy clients keep their limit; idle ones do not hold the chip up.
+                break;
+            }
+            uint8_t native = client->wake_sources & info->wake_sources;
+            if (native && info->exit_us > client->max_latency_us) {
+                allowed = false;  // Waking up would take longer than the client can wait.
+                break;
+            }
+            if (client->wake_sources & ~info->wake_sources) {
+                // Cannot wake on this source here: come back in time to poll it.
+                int64_t poll = now_us + client->max_latency_us;
+                due = poll < due ? poll : due;
+            }
+            armed |= native;
+            if (due < deadline) {
+                deadline = due;
+                limiting = i;
+            }
+        }
+        if (!allowed) {
+            continue;
+        }
+
+        uint32_t transition = info->entry_us + info->exit_us;
+        uint64_t energy;
+        if (deadline == PM_NO_DEADLINE) {
+            energy = 0;  // Open ended: only the deepest allowed state is worth considering.
+        } else {
+            int64_t window = deadline - now_us;
+            if (window < (int64_t)transition) {
+                continue;  // Could not get back in time.
+            }
+            energy = energy_nj(pm->states[PM_STATE_ACTIVE].power_uw, transition) +
+                     energy_nj(info->power_uw, window - transition);
+        }
+        if (!found || energy < best_energy) {
+            found = true;
+            best_energy = energy;
+            best.state = state;
+            best.wake_at_us = deadline == PM_NO_DEADLINE ? PM_NO_DEADLINE : deadline - info->exit_us;
+            best.wake_sources = armed;
+            best.limiting_client = limiting;
+        }
+    }
+
+    if (!found) {
+        // Nothing pays off: wait in ACTIVE for the nearest deadline.
+        for (uint8_t i = 0; i < pm->num_clients; i++) {
+            best.wake_sources |= pm->clients[i].wake_sources;
+            if (pm->clients[i].deadline_us < best.wake_at_us) {
+                best.wake_at_us = pm->clients[i].deadline_us;
+                best.limiting_client = i;
+            }
+        }
+    }
+    return best;
+}
+
+static uint8_t source_index(uint8_t cause) {
+    return cause == PM_WAKE_EXT0 ? 1 : (cause == PM_WAKE_ADC_THRESHOLD ? 2 : 0);
+}
+
+pm_wake_t pm_sleep(pm_t *pm) {
+    const pm_backend_t *backend = &pm->backend;
+    int64_t start = backend->now_us(backend->ctx);
+    pm_decision_t decision = pm_decide(pm, start);
+    const pm_state_info_t *info = &pm->states[decision.state];
+
+    pm_wake_t wake = backend->sleep(backend->ctx, &decision, info);
+    int64_t resumed = backend->now_us(backend->ctx);
+
+    // Entry and exit run at active power; the rest of the stay at the state's power.
+    pm_stats_t *stats = &pm->stats;
+    int64_t elapsed = resumed - start;
+    int64_t transition = info->entry_us + info->exit_us;
+    transition = transition < elapsed ? transition : elapsed;
+    stats->entries[decision.state]++;
+    stats->time_us[decision.state] += elapsed;
+    stats->energy_nj[decision.state] += energy_nj(pm->states[PM_STATE_ACTIVE].power_uw, transition) +
+                                        energy_nj(info->power_uw, elapsed - transition);
+    stats->wakes_by_source[source_index(wake.cause)]++;
+
+    if (wake.cause == PM_WAKE_TIMER) {
+        if (decision.limiting_client >= 0 && resumed > pm->clients[decision.limiting_client].deadline_us) {
+            stats->deadline_misses++;
+        }
+    } else {
+        pm_record_latency(pm, wake.event_us);
+    }
+    return wake;
+}
+
+void pm_record_latency(pm_t *pm, int64_t event_us) {
+    int64_t latency = pm->backend.now_us(pm->backend.ctx) - event_us;
+    pm->stats.latency_count++;
+    pm->stats.latency_total_us += latency;
+    if (latency > pm->stats.latency_max_us) {
+        pm->stats.latency_max_us = latency;
+    }
+}
+
+uint32_t pm_average_power_uw(const pm_t *pm) {
+    uint64_t energy = 0;
+    int64_t time = 0;
+    for (int state = 0; state < PM_STATE_COUNT; state++) {
+        energy += pm->stats.energy_nj[state];
+        time += pm->stats.time_us[state];
+    }
+    return time > 0 ? (uint32_t)(energy * 1000 / time) : 0;
+}
+
+// ---------------------------------------------------------------------------
+// Simulated backend
+// ---------------------------------------------------------------------------
+
+static int64_t sim_now_us(void *ctx) {
+    pm_sim_t *sim = ctx;
+    return sim->clock_us;
+}
+
+static pm_wake_t sim_sleep(void *ctx, const pm_decision_t *decision, const pm_state_info_t *info) {
+    pm_sim_t *sim = ctx;
+    int64_t asleep = sim->clock_us + info->entry_us;
+    pm_wake_t wake = { .cause = PM_WAKE_TIMER, .event_us = decision->wake_at_us };
+
+    // The first armed event before the timer ends the stay; unarmed ones wait to be polled.
+    for (uint8_t i = 0; i < sim->num_events; i++) {
+        const pm_sim_event_t *event = &sim->events[i];
+        if (event->time_us >= wake.event_us) {
+            break;
+        }
+        if (!(sim->delivered & (1u << i)) && (event->source & decision->wake_sources)) {
+            sim->delivered |= 1u << i;
+            wake.cause = event->source;
+            wake.event_us = event->time_us;
+            break;
+        }
+    }
+
+    int64_t woke = wake.event_us > asleep ? wake.event_us : asleep;
+    if (wake.event_us == PM_NO_DEADLINE) {
+        woke = asleep;  // Nothing can end this stay; the scenario is over.
+    }
+    sim->clock_us = woke + info->exit_us;
+    return wake;
+}
+
+pm_backend_t pm_sim_backend(pm_sim_t *sim, const pm_sim_event_t *events, uint8_t num_events) {
+    memset(sim, 0, sizeof(*sim));
+    sim->events = events;
+    sim->num_events = num_events > PM_SIM_MAX_EVENTS ? PM_SIM_MAX_EVENTS : num_events;
+    pm_backend_t backend = {
+        .now_us = sim_now_us,
+        .sleep = sim_sleep,
+        .ctx = sim,
+    };
+    return backend;
+}
+
+bool pm_sim_take(pm_sim_t *sim, uint8_t source, int64_t *event_us) {
+    for (uint8_t i = 0; i < sim->num_events && sim->events[i].time_us <= sim->clock_us; i++) {
+        if (!(sim->delivered & (1u << i)) && sim->events[i].source == source) {
+            sim->delivered |= 1u << i;
+            *event_us = sim->events[i].time_us;
+            return true;
+        }
+    }
+    return false;
+}
+
+// ---------------------------------------------------------------------------
+// ESP32 backend
+// ---------------------------------------------------------------------------
+
+#ifdef ESP_PLATFORM
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "esp_log.h"
+#include "esp_sleep.h"
+#include "esp_timer.h"
+
+static int64_t esp_backend_now_us(void *ctx) {
+    return esp_timer_get_time();
+}
+
+static pm_wake_t esp_backend_sleep(void *ctx, const pm_decision_t *decision, const pm_state_info_t *info) {
+    pm_esp_t *esp = ctx;
+    int64_t now = esp_timer_get_time();
+    int64_t wait_us = decision->wake_at_us == PM_NO_DEADLINE ? -1 : decision->wake_at_us - now;
+    pm_wake_t wake = { .cause = PM_WAKE_TIMER, .event_us = decision->wake_at_us };
+
+    if (decision->state == PM_STATE_ACTIVE) {
+        // Round up to whole ticks: truncating would wake early, and a sub-tick
+        // wait would become a zero delay that spins through pm_sleep().
+        const int64_t tick_us = 1000000 / configTICK_RATE_HZ;
+        TickType_t ticks = wait_us < 0 ? portMAX_DELAY : (TickType_t)((wait_us + tick_us - 1) / tick_us);
+        vTaskDelay(ticks > 0 ? ticks : 1);
+        return wake;
+    }
+
+    esp_sleep_disable_wakeup_source(ESP_SLEEP_WAKEUP_ALL);
+    if (wait_us >= 0) {
+        esp_sleep_enable_timer_wakeup(wait_us > 0 ? wait_us : 1);
+    }
+
+    if (decision->state == PM_STATE_DEEP_SLEEP) {
+        if (decision->wake_sources & PM_WAKE_EXT0) {
+            esp_sleep_enable_ext0_wakeup(esp->ext0_gpio, esp->ext0_level);
+        }
+        esp_deep_sleep_start();  // Does not return; the next boot starts in app_main.
+    }
+
+    // Light sleep wakes on the plain GPIO level, so the pin stays a digital input.
+    if (decision->wake_sources & PM_WAKE_EXT0) {
+        gpio_wakeup_enable(esp->ext0_gpio, esp->ext0_level ? GPIO_INTR_HIGH_LEVEL : GPIO_INTR_LOW_LEVEL);
+        esp_sleep_enable_gpio_wakeup();
+    }
+    esp_light_sleep_start();
+    if (decision->wake_sources & PM_WAKE_EXT0) {
+        gpio_wakeup_disable(esp->ext0_gpio);
+    }
+
+    if (esp_sleep_get_wakeup_cause() == ESP_SLEEP_WAKEUP_GPIO) {
+        wake.cause = PM_WAKE_EXT0;
+        wake.event_us = esp_timer_get_time() - info->exit_us;  // The event time itself is not latched.
+    }
+    return wake;
+}
+
+pm_backend_t pm_esp_backend(pm_esp_t *esp, gpio_num_t ext0_gpio, int ext0_level) {
+    esp->ext0_gpio = ext0_gpio;
+    esp->ext0_level = ext0_level;
+    pm_backend_t backend = {
+        .now_us = esp_backend_now_us,
+        .sleep = esp_backend_sleep,
+        .ctx = esp,
+    };
+    return backend;
+}
+
+void pm_log_stats(const pm_t *pm, const char *tag) {
+    static const char *names[PM_STATE_COUNT] = { "active", "light", "deep" };
+    const pm_stats_t *stats = &pm->stats;
+    for (int state = 0; state < PM_STATE_COUNT; state++) {
+        if (stats->entries[state]) {
+            ESP_LOGI(tag, "%-6s %5lu entries, %8lld ms, %8llu uJ", names[state], stats->entries[state],
+                     stats->time_us[state] / 1000, stats->energy_nj[state] / 1000);
+        }
+    }
+    ESP_LOGI(tag, "avg %lu uW, wakes timer/ext0/adc %lu/%lu/%lu, %lu deadline misses, latency avg %lld us max %lld us",
+             pm_average_power_uw(pm), stats->wakes_by_source[0], stats->wakes_by_source[1], stats->wakes_by_source[2],
+             stats->deadline_misses, stats->latency_count ? stats->latency_total_us / stats->latency_count : 0,
+             stats->latency_max_us);
+}
+
+#endif
@@ -0,0 +1,154 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// Deadline-driven power manager.
+//
+// Components register as clients with the wake sources they depend on, how
+// long they can tolerate waiting after such an event, and the deepest state
+// they can live with while busy (a blinking LED cannot survive deep sleep).
+// Before idling, each client publishes its next deadline. pm_decide() then
+// looks at every sleep state and keeps the one that uses the least estimated
+// energy while still meeting the nearest deadline once its entry and exit
+// cost are paid.
+//
+// A wake source that a state cannot wake on (the ESP32 has no ADC comparator
+// outside the ULP, for example) is turned into polling: the state must then
+// wake within the client's latency budget so the client can check by itself.
+//
+// The backend is either the ESP32 sleep API or a simulated clock with a
+// scripted list of wake events, so a policy and a scenario can be replayed on
+// a Linux host. Energy and wake latency are estimated from the state table.
+
+#define PM_MAX_CLIENTS 8
+#define PM_NO_DEADLINE INT64_MAX
+
+typedef enum {
+    PM_STATE_ACTIVE,  // CPU idles in a task delay, everything stays powered.
+    PM_STATE_LIGHT_SLEEP,  // CPU and most peripherals clock-gated, RAM and GPIO levels kept.
+    PM_STATE_DEEP_SLEEP,  // Only the RTC domain stays on; waking reboots into app_main.
+    PM_STATE_COUNT,
+} pm_state_t;
+
+// Wake sources, used as bit masks.
+#define PM_WAKE_TIMER (1 << 0)
+#define PM_WAKE_EXT0 (1 << 1)  // RTC GPIO level (the button).
+#define PM_WAKE_ADC_THRESHOLD (1 << 2)  // Analog input crossing a threshold.
+
+typedef struct {
+    uint32_t power_uw;  // Draw while in the state.
+    uint32_t entry_us;  // Time to enter, spent at active power.
+    uint32_t exit_us;  // Time from the wake event until code runs again, at active power.
+    uint8_t wake_sources;  // Sources that can end the state.
+} pm_state_info_t;
+
+// Rough ESP32 figures (datasheet currents at 3.3 V, default bootloader for the deep sleep exit).
+extern const pm_state_info_t pm_esp32_states[PM_STATE_COUNT];
+
+typedef struct {
+    const char *name;
+    int64_t deadline_us;  // Next time the client must run, PM_NO_DEADLINE if none.
+    uint8_t wake_sources;  // Asynchronous events the client must be woken for.
+    uint32_t max_latency_us;  // Longest acceptable delay from such an event to running code.
+    pm_state_t max_state;  // Deepest state the client tolerates while it has a deadline.
+} pm_client_t;
+
+typedef struct {
+    pm_state_t state;
+    int64_t wake_at_us;  // Timer wake, PM_NO_DEADLINE if none.
+    uint8_t wake_sources;  // Asynchronous sources armed for the state.
+    int8_t limiting_client;  // Client that set wake_at_us, -1 if none.
+} pm_decision_t;
+
+typedef struct {
+    uint8_t cause;  // PM_WAKE_* bit that ended the state.
+    int64_t event_us;  // When the wake event happened.
+} pm_wake_t;
+
+// sleep() stays in the decided state until the timer or an armed source
+// fires and reports which one. On the device a deep sleep never returns.
+typedef struct {
+    int64_t (*now_us)(void *ctx);
+    pm_wake_t (*sleep)(void *ctx, const pm_decision_t *decision, const pm_state_info_t *info);
+    void *ctx;
+} pm_backend_t;
+
+typedef struct {
+    uint32_t entries[PM_STATE_COUNT];
+    int64_t time_us[PM_STATE_COUNT];
+    uint64_t energy_nj[PM_STATE_COUNT];  // Transitions are charged to the state they lead into.
+    uint32_t wakes_by_source[3];  // Timer, ext0, ADC threshold.
+    uint32_t deadline_misses;  // Timer wakes that resumed after the limiting deadline.
+    uint32_t latency_count;  // Asynchronous events serviced.
+    int64_t latency_total_us;
+    int64_t latency_max_us;
+} pm_stats_t;
+
+typedef struct {
+    pm_state_info_t states[PM_STATE_COUNT];
+    pm_client_t clients[PM_MAX_CLIENTS];
+    uint8_t num_clients;
+    pm_backend_t backend;
+    pm_stats_t stats;
+} pm_t;
+
+// states may be NULL for pm_esp32_states.
+void pm_init(pm_t *pm, const pm_backend_t *backend, const pm_state_info_t *states);
+
+// Returns the client id, or -1 when the table is full.
+int pm_register(pm_t *pm, const char *name, uint8_t wake_sources, uint32_t max_latency_us, pm_state_t max_state);
+void pm_set_deadline(pm_t *pm, int client, int64_t deadline_us);
+
+// Policy only: the state and wake time pm_sleep() would use at now_us.
+pm_decision_t pm_decide(const pm_t *pm, int64_t now_us);
+
+// Decide, sleep through the backend, and account energy and latency.
+pm_wake_t pm_sleep(pm_t *pm);
+
+// Record the latency of an event found by polling (a source the state could
+// not wake on), measured from when it happened to now.
+void pm_record_latency(pm_t *pm, int64_t event_us);
+
+// Average power over everything accounted so far, in microwatts.
+uint32_t pm_average_power_uw(const pm_t *pm);
+
+// Simulated backend: a clock that jumps straight to the next wake, and a
+// time-ordered script of asynchronous events.
+typedef struct {
+    int64_t time_us;
+    uint8_t source;  // PM_WAKE_EXT0 or PM_WAKE_ADC_THRESHOLD.
+} pm_sim_event_t;
+
+#define PM_SIM_MAX_EVENTS 32
+
+typedef struct {
+    int64_t clock_us;
+    const pm_sim_event_t *events;
+    uint8_t num_events;
+    uint32_t delivered;  // Bit i set once events[i] has woken the chip or been polled.
+} pm_sim_t;
+
+pm_backend_t pm_sim_backend(pm_sim_t *sim, const pm_sim_event_t *events, uint8_t num_events);
+
+// For polled sources: take the oldest undelivered event of this source that
+// has already happened. Returns false if there is none.
+bool pm_sim_take(pm_sim_t *sim, uint8_t source, int64_t *event_us);
+
+#ifdef ESP_PLATFORM
+
+#include "driver/gpio.h"
+
+// ESP32 backend: ACTIVE waits with vTaskDelay, light sleep wakes on the timer
+// and a GPIO level, deep sleep wakes on the timer and ext0.
+typedef struct {
+    gpio_num_t ext0_gpio;
+    int ext0_level;  // Level that wakes the chip.
+} pm_esp_t;
+
+pm_backend_t pm_esp_backend(pm_esp_t *esp, gpio_num_t ext0_gpio, int ext0_level);
+
+void pm_log_stats(const pm_t *pm, const char *tag);
+
+#endif
@@ -0,0 +1,97 @@
+#include <string.h>
+#include "rtc_snapshot.h"
+
+// Reflected CRC-32 (IEEE 802.3), one nibble at a time: a 64-byte table is
+// enough for the few hundred bytes sealed per sleep.
+static const uint32_t crc32_nibble[16] = {
+    0x00000000, 0x1DB71064, 0x3B6E20C8, 0x26D930AC, 0x76DC4190, 0x6B6B51F4, 0x4DB26158, 0x5005713C,
+    0xEDB88320, 0xF00F9344, 0xD6D6A3E8, 0xCB61B38C, 0x9B64C2B0, 0x86D3D2D4, 0xA00AE278, 0xBDBDF21C,
+};
+
+uint32_t rtc_snapshot_crc32(uint32_t crc, const void *data, size_t length) {
+    const uint8_t *bytes = data;
+    crc = ~crc;
+    for (size_t i = 0; i < length; i++) {
+        crc ^= bytes[i];
+        crc = (crc >> 4) ^ crc32_nibble[crc & 0x0F];
+        crc = (crc >> 4) ^ crc32_nibble[crc & 0x0F];
+    }
+    return ~crc;
+}
+
+static uint32_t snapshot_crc(const rtc_snapshot_t *snap, const void *payload) {
+    uint32_t crc = rtc_snapshot_crc32(0, snap, offsetof(rtc_snapshot_t, crc));
+    return rtc_snapshot_crc32(crc, payload, snap->length);
+}
+
+void rtc_snapshot_seal(rtc_snapshot_t *snap, const void *payload, uint16_t length, uint16_t version, uint32_t build_id) {
+    uint32_t seals = snap->magic == RTC_SNAPSHOT_MAGIC ? snap->seals + 1 : 1;
+    snap->magic = RTC_SNAPSHOT_MAGIC;
+    snap->build_id = build_id;
+    snap->version = version;
+    snap->length = length;
+    snap->seals = seals;
+    snap->crc = snapshot_crc(snap, payload);
+}
+
+rtc_snapshot_status_t rtc_snapshot_check(const rtc_snapshot_t *snap, const void *payload, uint16_t length,
+                                         uint16_t version, uint32_t build_id) {
+    if (snap->magic != RTC_SNAPSHOT_MAGIC) {
+        return RTC_SNAPSHOT_EMPTY;
+    }
+    if (snap->build_id != build_id) {
+        return RTC_SNAPSHOT_OTHER_BUILD;
+    }
+    if (snap->version != version || snap->length != length) {
+        return RTC_SNAPSHOT_OTHER_LAYOUT;
+    }
+    return snap->crc == snapshot_crc(snap, payload) ? RTC_SNAPSHOT_OK : RTC_SNAPSHOT_CORRUPT;
+}
+
+void rtc_snapshot_invalidate(rtc_snapshot_t *snap) {
+    memset(snap, 0, sizeof(*snap));
+}
+
+const char *rtc_snapshot_status_name(rtc_snapshot_status_t status) {
+    static const char *names[] = { "valid", "empty", "other build", "other layout", "corrupt" };
+    return status <= RTC_SNAPSHOT_CORRUPT ? names[status] : "?";
+}
+
+void rtc_resume_record(rtc_resume_stats_t *stats, bool warm, int64_t elapsed_us, int64_t setup_us) {
+    rtc_resume_path_t *path = warm ? &stats->warm : &stats->cold;
+    path->count++;
+    path->last_us = elapsed_us;
+    path->total_us += elapsed_us;
+    path->setup_total_us += setup_us;
+    if (elapsed_us > path->max_us) {
+        path->max_us = elapsed_us;
+    }
+}
+
+#ifdef ESP_PLATFORM
+
+#include "esp_app_desc.h"
+#include "esp_log.h"
+
+uint32_t rtc_snapshot_build_id(void) {
+    const uint8_t *sha = esp_app_get_description()->app_elf_sha256;
+    return (uint32_t)sha[0] | (uint32_t)sha[1] << 8 | (uint32_t)sha[2] << 16 | (uint32_t)sha[3] << 24;
+}
+
+void rtc_resume_log_stats(const rtc_resume_stats_t *stats, const char *tag) {
+    const rtc_resume_path_t *paths[] = { &stats->cold, &stats->warm };
+    const char *names[] = { "cold", "warm" };
+    for (int i = 0; i < 2; i++) {
+        const rtc_resume_path_t *path = paths[i];
+        if (path->count) {
+            // esp_timer starts after the ROM and bootloader, so their time is not included.
+            ESP_LOGI(tag,
+                     "%s start to first work, since esp_timer start: %lu boots, last %lld us, avg %lld us "
+                     "(%lld us without setup), max %lld us",
+                     names[i], path->count, path->last_us, path->total_us / path->count,
+                     (path->total_us - path->setup_total_us) / path->count, path->max_us);
+        }
+    }
+}
+
+#endif
@@ -0,0 +1,77 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// Versioned, checksummed state snapshot for RTC slow memory.
+//
+// The application keeps its snapshot payload (peripheral configuration,
+// calibration results, application state) in an RTC_DATA_ATTR struct next to
+// an rtc_snapshot_t header, and seals it right before deep sleep. On the next
+// boot rtc_snapshot_check() tells whether the payload can be trusted: it must
+// carry the magic, come from the same firmware build, have the expected layout
+// version and length, and match its CRC-32. Only then does the application
+// take the warm path and restore from the payload instead of reinitialising.
+//
+// Any write to the payload after sealing breaks the CRC, so a reset in the
+// middle of an update falls back to the cold path by itself.
+
+#define RTC_SNAPSHOT_MAGIC 0x534E4150  // "SNAP"
+
+typedef struct {
+    uint32_t magic;
+    uint32_t build_id;  // Firmware that wrote it; another image may lay the payload out differently.
+    uint16_t version;  // Payload layout version, bumped by the application.
+    uint16_t length;  // Payload bytes.
+    uint32_t seals;  // Times sealed since the last cold start.
+    uint32_t crc;  // CRC-32 of the fields above and the payload.
+} rtc_snapshot_t;
+
+typedef enum {
+    RTC_SNAPSHOT_OK,
+    RTC_SNAPSHOT_EMPTY,  // Never sealed (power-on, or invalidated).
+    RTC_SNAPSHOT_OTHER_BUILD,
+    RTC_SNAPSHOT_OTHER_LAYOUT,  // Version or length differ.
+    RTC_SNAPSHOT_CORRUPT,  // CRC mismatch.
+} rtc_snapshot_status_t;
+
+uint32_t rtc_snapshot_crc32(uint32_t crc, const void *data, size_t length);
+
+void rtc_snapshot_seal(rtc_snapshot_t *snap, const void *payload, uint16_t length, uint16_t version, uint32_t build_id);
+rtc_snapshot_status_t rtc_snapshot_check(const rtc_snapshot_t *snap, const void *payload, uint16_t length,
+                                         uint16_t version, uint32_t build_id);
+void rtc_snapshot_invalidate(rtc_snapshot_t *snap);
+
+const char *rtc_snapshot_status_name(rtc_snapshot_status_t status);
+
+// Wake-to-first-useful-work time per boot path, kept in RTC memory by the
+// caller so it accumulates across deep sleep cycles. Times are whatever clock
+// the caller passes; on the ESP32 that is esp_timer, which starts after the
+// ROM and bootloader have run. One-off setup that only one path does (the
+// cold path's sensor baseline, say) is passed separately, so both paths can
+// be compared with and without it.
+typedef struct {
+    uint32_t count;
+    int64_t last_us;
+    int64_t total_us;
+    int64_t max_us;
+    int64_t setup_total_us;  // Part of total_us spent in that setup.
+} rtc_resume_path_t;
+
+typedef struct {
+    rtc_resume_path_t cold;
+    rtc_resume_path_t warm;
+} rtc_resume_stats_t;
+
+// elapsed_us includes setup_us.
+void rtc_resume_record(rtc_resume_stats_t *stats, bool warm, int64_t elapsed_us, int64_t setup_us);
+
+#ifdef ESP_PLATFORM
+
+// First word of the running image's ELF SHA-256.
+uint32_t rtc_snapshot_build_id(void);
+
+void rtc_resume_log_stats(const rtc_resume_stats_t *stats, const char *tag);
+
+#endif
@@ -0,0 +1,165 @@
+#include <string.h>
+#include "sample_log.h"
+
+#define RING_MASK (SAMPLE_LOG_CAPACITY - 1)
+
+void sample_log_init(sample_log_t *log) {
+    memset(log, 0, sizeof(*log));
+    log->magic = SAMPLE_LOG_MAGIC;
+}
+
+// A record length that reading and dropping can step over without looping.
+static inline bool record_len_ok(const sample_log_t *log, uint32_t pos, uint8_t len) {
+    return len >= SAMPLE_LOG_HEADER_SIZE && len <= log->head - pos;
+}
+
+bool sample_log_valid(const sample_log_t *log) {
+    if (log->magic != SAMPLE_LOG_MAGIC || sample_log_used(log) > SAMPLE_LOG_CAPACITY) {
+        return false;
+    }
+    for (uint32_t pos = log->tail; pos != log->head;) {
+        uint8_t len = log->data[pos & RING_MASK];
+        if (!record_len_ok(log, pos, len)) {
+            return false;
+        }
+        pos += len;
+    }
+    return true;
+}
+
+static inline void put_u16(uint8_t *p, uint16_t v) {
+    p[0] = v & 0xFF;
+    p[1] = v >> 8;
+}
+
+static inline uint16_t get_u16(const uint8_t *p) {
+    return (uint16_t)(p[0] | p[1] << 8);
+}
+
+size_t sample_log_encode(uint8_t *out, size_t out_size, uint32_t time_ms, uint16_t interval_ms,
+                         const uint16_t *samples, size_t count) {
+    size_t limit = out_size < SAMPLE_LOG_MAX_RECORD ? out_size : SAMPLE_LOG_MAX_RECORD;
+    if (count == 0 || limit < SAMPLE_LOG_HEADER_SIZE) {
+        return 0;
+    }
+    put_u16(&out[1], time_ms & 0xFFFF);
+    put_u16(&out[3], time_ms >> 16);
+    put_u16(&out[5], interval_ms);
+    put_u16(&out[7], samples[0]);
+
+    size_t len = SAMPLE_LOG_HEADER_SIZE;
+    for (size_t i = 1; i < count; i++) {
+        int32_t delta = (int32_t)samples[i] - samples[i - 1];
+        uint32_t zigzag = ((uint32_t)delta << 1) ^ (uint32_t)(delta >> 31);
+        do {
+            if (len >= limit) {
+                return 0;
+            }
+            out[len++] = (zigzag & 0x7F) | (zigzag > 0x7F ? 0x80 : 0);
+            zigzag >>= 7;
+        } while (zigzag);
+    }
+    out[0] = (uint8_t)len;
+    return len;
+}
+
+size_t sample_log_decode(const uint8_t *record, size_t len, uint32_t *time_ms, uint16_t *interval_ms,
+                         uint16_t *samples, size_t max_samples) {
+    if (len < SAMPLE_LOG_HEADER_SIZE || record[0] != len || max_samples == 0) {
+        return 0;
+    }
+    *time_ms = get_u16(&record[1]) | (uint32_t)get_u16(&record[3]) << 16;
+    *interval_ms = get_u16(&record[5]);
+    samples[0] = get_u16(&record[7]);
+
+    size_t count = 1;
+    size_t pos = SAMPLE_LOG_HEADER_SIZE;
+    while (pos < len && count < max_samples) {
+        uint32_t zigzag = 0;
+        uint8_t shift = 0;
+        uint8_t byte;
+        do {
+            if (pos >= len || shift > 14) {
+                return 0;  // Truncated, or longer than any 16-bit step needs.
+            }
+            byte = record[pos++];
+            zigzag |= (uint32_t)(byte & 0x7F) << shift;
+            shift += 7;
+        } while (byte & 0x80);
+        int32_t delta = (int32_t)(zigzag >> 1) ^ -(int32_t)(zigzag & 1);
+        samples[count] = (uint16_t)(samples[count - 1] + delta);
+        count++;
+    }
+    return count;
+}
+
+static void ring_copy_out(const sample_log_t *log, uint32_t pos, uint8_t *out, size_t len) {
+    size_t first = SAMPLE_LOG_CAPACITY - (pos & RING_MASK);
+    first = first < len ? first : len;
+    memcpy(out, &log->data[pos & RING_MASK], first);
+    memcpy(out + first, log->data, len - first);
+}
+
+// Drop the oldest record to make room, keeping the stats honest. A length
+// that cannot be stepped over means the ring is corrupt, so it is emptied
+// rather than walked.
+static void drop_oldest(sample_log_t *log) {
+    uint8_t record[SAMPLE_LOG_MAX_RECORD];
+    uint16_t samples[SAMPLE_LOG_MAX_RECORD];
+    uint32_t time_ms;
+    uint16_t interval_ms;
+    uint8_t len = log->data[log->tail & RING_MASK];
+    if (!record_len_ok(log, log->tail, len)) {
+        log->tail = log->head;
+        log->stats.resets++;
+        return;
+    }
+    ring_copy_out(log, log->tail, record, len);
+    log->stats.dropped_records++;
+    log->stats.dropped_samples += sample_log_decode(record, len, &time_ms, &interval_ms, samples, SAMPLE_LOG_MAX_RECORD);
+    log->tail += len;
+}
+
+bool sample_log_append(sample_log_t *log, uint32_t time_ms, uint16_t interval_ms, const uint16_t *samples, size_t count) {
+    uint8_t record[SAMPLE_LOG_MAX_RECORD];
+    size_t len = sample_log_encode(record, sizeof(record), time_ms, interval_ms, samples, count);
+    if (len == 0) {
+        return false;
+    }
+    while (SAMPLE_LOG_CAPACITY - sample_log_used(log) < len) {
+        drop_oldest(log);
+    }
+
+    size_t pos = log->head & RING_MASK;
+    size_t first = SAMPLE_LOG_CAPACITY - pos;
+    first = first < len ? first : len;
+    memcpy(&log->data[pos], record, first);
+    memcpy(log->data, record + first, len - first);
+    log->head += len;
+
+    log->stats.records++;
+    log->stats.samples += count;
+    log->stats.bytes += len;
+    return true;
+}
+
+size_t sample_log_read(const sample_log_t *log, uint32_t *cursor, uint8_t *record, size_t record_size) {
+    if (*cursor == log->head) {
+        return 0;
+    }
+    // sample_log_valid() has walked these lengths at boot, and appends only
+    // write good ones, so a bad length here is a bug rather than decay.
+    uint8_t len = log->data[*cursor & RING_MASK];
+    if (!record_len_ok(log, *cursor, len) || len > record_size) {
+        return 0;
+    }
+    ring_copy_out(log, *cursor, record, len);
+    *cursor += len;
+    return len;
+}
+
+void sample_log_release(sample_log_t *log, uint32_t cursor) {
+    if (cursor - log->tail <= sample_log_used(log)) {
+        log->tail = cursor;
+    }
+}
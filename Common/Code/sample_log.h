@@ -0,0 +1,79 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// Delta-encoded sample log for RTC memory.
+//
+// A duty-cycled node wakes briefly, appends one record of samples, and goes
+// back to sleep. Only when the log passes its watermark does it bring up a
+// transport and flush everything at once. The log is a byte ring of
+// variable-length records (multi-byte fields little endian):
+//
+//   0   len               record length in bytes, header included
+//   1   time_ms (u32)     timestamp of the first sample
+//   5   interval_ms (u16) spacing of the samples in this record
+//   7   first (u16)       first sample value
+//   9   deltas            one zigzag varint per further sample
+//
+// A varint carries 7 bits per byte, so steps of up to +-63 codes take one
+// byte. When the ring is full the oldest records are dropped. Nothing here
+// depends on ESP-IDF, so the format can be checked on a host.
+
+#define SAMPLE_LOG_CAPACITY 2048  // Power of two; leaves most of the 8 KB RTC slow memory free.
+#define SAMPLE_LOG_HEADER_SIZE 9
+#define SAMPLE_LOG_MAX_RECORD 255
+#define SAMPLE_LOG_MAGIC 0x534C4F47  // "SLOG"
+
+typedef struct {
+    uint32_t records;  // Records appended.
+    uint32_t samples;  // Samples appended.
+    uint32_t bytes;  // Encoded bytes appended.
+    uint32_t dropped_records;  // Oldest records overwritten because the ring was full.
+    uint32_t dropped_samples;
+    uint32_t resets;  // Times a corrupt record length forced the ring to be emptied.
+} sample_log_stats_t;
+
+typedef struct {
+    uint32_t magic;
+    uint32_t head;  // Bytes written (free running).
+    uint32_t tail;  // Bytes released (free running).
+    sample_log_stats_t stats;
+    uint8_t data[SAMPLE_LOG_CAPACITY];
+} sample_log_t;
+
+void sample_log_init(sample_log_t *log);
+
+// True if the log survived (RTC memory after deep sleep) in a usable state:
+// the magic is present and the record lengths walk from tail exactly to head.
+bool sample_log_valid(const sample_log_t *log);
+
+// Encode one record. Returns its length, or 0 if it would not fit in out or
+// in SAMPLE_LOG_MAX_RECORD.
+size_t sample_log_encode(uint8_t *out, size_t out_size, uint32_t time_ms, uint16_t interval_ms,
+                         const uint16_t *samples, size_t count);
+
+// Decode a record into at most max_samples values. Returns the sample count,
+// or 0 if the record is malformed.
+size_t sample_log_decode(const uint8_t *record, size_t len, uint32_t *time_ms, uint16_t *interval_ms,
+                         uint16_t *samples, size_t max_samples);
+
+// Encode and append, dropping the oldest records to make room. Returns false
+// if the record cannot be encoded at all.
+bool sample_log_append(sample_log_t *log, uint32_t time_ms, uint16_t interval_ms, const uint16_t *samples, size_t count);
+
+static inline size_t sample_log_used(const sample_log_t *log) {
+    return log->head - log->tail;
+}
+
+// Reading walks records from the oldest one with a cursor, so a flush can
+// stop part way. Start at sample_log_begin(); sample_log_read() copies the
+// record at the cursor and advances it, returning 0 at the end.
+// sample_log_release() frees everything before a cursor once it is delivered.
+static inline uint32_t sample_log_begin(const sample_log_t *log) {
+    return log->tail;
+}
+
+size_t sample_log_read(const sample_log_t *log, uint32_t *cursor, uint8_t *record, size_t record_size);
+void sample_log_release(sample_log_t *log, uint32_t cursor);
@@ -0,0 +1,50 @@
+#include "servo_duty_map.h"
+
+_Static_assert(SERVO_DUTY_MAX < (1u << SERVO_PWM_RESOLUTION_BITS), "Pulse endpoint does not fit the duty resolution");
+_Static_assert(SERVO_DUTY_MIN < SERVO_DUTY_MAX, "Pulse endpoints are reversed");
+
+// Expand the table 4096 entries at a time: each level repeats the one below
+// with an increasing base offset.
+#define DUTY_4(b) SERVO_DUTY_FOR_RAW(b), SERVO_DUTY_FOR_RAW((b) + 1), SERVO_DUTY_FOR_RAW((b) + 2), SERVO_DUTY_FOR_RAW((b) + 3)
+#define DUTY_16(b) DUTY_4(b), DUTY_4((b) + 4), DUTY_4((b) + 8), DUTY_4((b) + 12)
+#define DUTY_64(b) DUTY_16(b), DUTY_16((b) + 16), DUTY_16((b) + 32), DUTY_16((b) + 48)
+#define DUTY_256(b) DUTY_64(b), DUTY_64((b) + 64), DUTY_64((b) + 128), DUTY_64((b) + 192)
+#define DUTY_1024(b) DUTY_256(b), DUTY_256((b) + 256), DUTY_256((b) + 512), DUTY_256((b) + 768)
+#define DUTY_4096(b) DUTY_1024(b), DUTY_1024((b) + 1024), DUTY_1024((b) + 2048), DUTY_1024((b) + 3072)
+
+const uint16_t servo_duty_map[SERVO_MAX_ADC_VALUE + 1] = { DUTY_4096(0) };
+
+void servo_stage_init(servo_stage_t *stage, uint16_t deadband, uint16_t max_step, uint16_t initial_raw) {
+    *stage = (servo_stage_t){
+        .deadband = deadband,
+        .max_step = max_step,
+        .raw = initial_raw & SERVO_MAX_ADC_VALUE,
+        .duty = servo_duty_map[initial_raw & SERVO_MAX_ADC_VALUE],
+    };
+}
+
+bool servo_stage_update(servo_stage_t *stage, uint16_t raw, uint32_t *duty) {
+    stage->updates++;
+
+    // Deadband: only accept inputs that moved far enough from the last accepted one.
+    int32_t delta_raw = (int32_t)(raw & SERVO_MAX_ADC_VALUE) - stage->raw;
+    if (delta_raw >= stage->deadband || -delta_raw >= stage->deadband) {
+        stage->raw = raw & SERVO_MAX_ADC_VALUE;
+    }
+
+    // Slew limit: move towards the target by at most max_step per update.
+    int32_t step = (int32_t)servo_duty_map[stage->raw] - stage->duty;
+    if (stage->max_step) {
+        step = step > stage->max_step ? stage->max_step : step;
+        step = step < -stage->max_step ? -stage->max_step : step;
+    }
+
+    if (step == 0) {
+        stage->suppressed++;
+        return false;
+    }
+    stage->duty += step;
+    stage->writes++;
+    *duty = stage->duty;
+    return true;
+}
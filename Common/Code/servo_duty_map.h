@@ -0,0 +1,51 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+
+// ADC -> servo PWM duty mapping.
+//
+// The 4096-entry raw-to-duty table is generated by the preprocessor from the
+// timer frequency, duty resolution and pulse endpoints below, so the control
+// loop does a single lookup instead of a multiply and divide per sample.
+
+#define SERVO_PWM_FREQ_HZ 50  // Standard hobby servo frame rate (20 ms period).
+#define SERVO_PWM_RESOLUTION_BITS 12  // Must match the LEDC timer duty resolution.
+#define SERVO_MIN_PULSE_US 1000  // Pulse width at raw code 0.
+#define SERVO_MAX_PULSE_US 2500  // Pulse width at raw code 4095, wide enough for full travel on most servos.
+
+#define SERVO_MAX_ADC_VALUE 4095  // Maximum value for 12-bit ADC resolution.
+
+// Convert a pulse width to LEDC duty counts, rounded to nearest.
+#define SERVO_PULSE_TO_DUTY(us) \
+    ((uint32_t)((((uint64_t)(us) * SERVO_PWM_FREQ_HZ << SERVO_PWM_RESOLUTION_BITS) + 500000) / 1000000))
+
+#define SERVO_DUTY_MIN SERVO_PULSE_TO_DUTY(SERVO_MIN_PULSE_US)
+#define SERVO_DUTY_MAX SERVO_PULSE_TO_DUTY(SERVO_MAX_PULSE_US)
+
+// Linear interpolation between the endpoints, rounded to nearest.
+#define SERVO_DUTY_FOR_RAW(raw) \
+    (SERVO_DUTY_MIN + (((raw) * (SERVO_DUTY_MAX - SERVO_DUTY_MIN)) + SERVO_MAX_ADC_VALUE / 2) / SERVO_MAX_ADC_VALUE)
+
+extern const uint16_t servo_duty_map[SERVO_MAX_ADC_VALUE + 1];
+
+// Output stage between the filtered ADC reading and the LEDC peripheral:
+// a deadband on the input, a slew-rate limit on the output, and suppression
+// of writes that would not change the duty.
+typedef struct {
+    uint16_t deadband;  // Raw-code changes smaller than this are ignored.
+    uint16_t max_step;  // Largest duty change per update, 0 disables slew limiting.
+    uint16_t raw;  // Input accepted by the deadband.
+    uint16_t duty;  // Duty currently applied to the peripheral.
+    uint32_t updates;  // Calls to servo_stage_update().
+    uint32_t writes;  // Updates that produced a new duty.
+    uint32_t suppressed;  // Updates where the peripheral was left untouched.
+} servo_stage_t;
+
+// The stage assumes the peripheral already outputs the duty for initial_raw;
+// write stage->duty once after init, since updates only report changes.
+void servo_stage_init(servo_stage_t *stage, uint16_t deadband, uint16_t max_step, uint16_t initial_raw);
+
+// Feed one filtered raw reading. Returns true and sets *duty when the LEDC
+// duty needs to be written, false when the write can be skipped.
+bool servo_stage_update(servo_stage_t *stage, uint16_t raw, uint32_t *duty);
@@ -0,0 +1,308 @@
+#include <string.h>
+#include "servo_output_engine.h"
+
+#ifdef ESP_PLATFORM
+#include "esp_timer.h"
+#else
+#include <time.h>
+#endif
+
+void servo_engine_init(servo_engine_t *engine, const servo_engine_backend_t *backend, const servo_engine_config_t *config) {
+    memset(engine, 0, sizeof(*engine));
+    engine->backend = *backend;
+    engine->config = *config;
+    if (engine->config.num_channels > SERVO_ENGINE_MAX_CHANNELS) {
+        engine->config.num_channels = SERVO_ENGINE_MAX_CHANNELS;
+    }
+}
+
+uint8_t servo_engine_apply(servo_engine_t *engine, const uint16_t *targets) {
+    const servo_engine_backend_t *backend = &engine->backend;
+    const servo_engine_config_t *config = &engine->config;
+    servo_engine_stats_t *stats = &engine->stats;
+    int64_t start = backend->now_us(backend->ctx);
+    uint32_t pending = 0;  // Channels to latch.
+    uint32_t fading = 0;  // Subset of pending that start a hardware fade.
+
+    // Stage every change first; nothing reaches the outputs until the latch below.
+    for (uint8_t i = 0; i < config->num_channels; i++) {
+        uint32_t target = targets[i];
+        uint32_t current = engine->duty[i];
+        if (target == current) {
+            stats->unchanged++;
+            continue;
+        }
+        if (start < engine->fade_end_us[i]) {
+            stats->deferred++;  // Retried on a later frame once the fade has finished.
+            continue;
+        }
+
+        uint32_t distance = target > current ? target - current : current - target;
+        if (config->fade_threshold && distance >= config->fade_threshold) {
+            backend->prepare_fade(backend->ctx, i, target, config->fade_time_ms);
+            engine->fade_end_us[i] = start + (int64_t)config->fade_time_ms * 1000;
+            fading |= 1u << i;
+            stats->fades++;
+        } else {
+            backend->set_duty(backend->ctx, i, target);
+            stats->writes++;
+        }
+        engine->duty[i] = target;
+        pending |= 1u << i;
+    }
+
+    // Latch all staged channels back to back; the hardware picks each one up
+    // at its next period boundary.
+    uint8_t applied = 0;
+    if (pending) {
+        backend->latch_begin(backend->ctx);
+        for (uint8_t i = 0; i < config->num_channels; i++) {
+            if (pending & (1u << i)) {
+                backend->latch(backend->ctx, i, (fading >> i) & 1);
+                applied++;
+            }
+        }
+        backend->latch_end(backend->ctx);
+    }
+
+    int64_t elapsed = backend->now_us(backend->ctx) - start;
+    stats->frames++;
+    stats->apply_us_total += elapsed;
+    if (elapsed > stats->apply_us_max) {
+        stats->apply_us_max = elapsed;
+    }
+    return applied;
+}
+
+// ---------------------------------------------------------------------------
+// Fake backend
+// ---------------------------------------------------------------------------
+
+static void fake_set_duty(void *ctx, uint8_t index, uint32_t duty) {
+    servo_engine_fake_t *fake = ctx;
+    fake->duty[index] = duty;
+    fake->register_writes += 2;  // duty + hpoint
+}
+
+static void fake_prepare_fade(void *ctx, uint8_t index, uint32_t duty, uint32_t time_ms) {
+    servo_engine_fake_t *fake = ctx;
+    (void)time_ms;
+    fake->duty[index] = duty;
+    fake->register_writes += 4;  // duty, step count, step size, cycles per step
+}
+
+static void fake_latch_begin(void *ctx) {
+    servo_engine_fake_t *fake = ctx;
+    fake->in_burst = true;
+}
+
+static void fake_latch(void *ctx, uint8_t index, bool fade) {
+    servo_engine_fake_t *fake = ctx;
+    (void)index;
+    (void)fade;
+    if (!fake->in_burst) {
+        fake->unsynchronised_latches++;
+    }
+    fake->register_writes++;
+}
+
+static void fake_latch_end(void *ctx) {
+    servo_engine_fake_t *fake = ctx;
+    fake->in_burst = false;
+    fake->latch_groups++;
+}
+
+static int64_t fake_now_us(void *ctx) {
+    (void)ctx;
+#ifdef ESP_PLATFORM
+    return esp_timer_get_time();
+#else
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+#endif
+}
+
+servo_engine_backend_t servo_engine_fake_backend(servo_engine_fake_t *fake) {
+    memset(fake, 0, sizeof(*fake));
+    servo_engine_backend_t backend = {
+        .set_duty = fake_set_duty,
+        .prepare_fade = fake_prepare_fade,
+        .latch_begin = fake_latch_begin,
+        .latch = fake_latch,
+        .latch_end = fake_latch_end,
+        .now_us = fake_now_us,
+        .ctx = fake,
+    };
+    return backend;
+}
+
+// ---------------------------------------------------------------------------
+// LEDC backend (ESP32 only)
+// ---------------------------------------------------------------------------
+
+#ifdef ESP_PLATFORM
+
+#include "soc/ledc_struct.h"
+
+#define LEDC_CHANNELS_PER_GROUP 8
+#define LEDC_LATCH_US_PER_CHANNEL 5  // ledc_update_duty or ledc_fade_start, with margin.
+
+#if SOC_LEDC_SUPPORT_HS_MODE
+#define LEDC_ENGINE_CHANNELS (2 * LEDC_CHANNELS_PER_GROUP)
+#else
+#define LEDC_ENGINE_CHANNELS LEDC_CHANNELS_PER_GROUP
+#endif
+
+static inline ledc_mode_t ledc_mode_for(uint8_t index) {
+#if SOC_LEDC_SUPPORT_HS_MODE
+    return index < LEDC_CHANNELS_PER_GROUP ? LEDC_LOW_SPEED_MODE : LEDC_HIGH_SPEED_MODE;
+#else
+    return LEDC_LOW_SPEED_MODE;
+#endif
+}
+
+static inline ledc_channel_t ledc_channel_for(uint8_t index) {
+    return (ledc_channel_t)(index % LEDC_CHANNELS_PER_GROUP);
+}
+
+static inline bool ledc_uses_high_speed(const servo_engine_ledc_t *ledc) {
+#if SOC_LEDC_SUPPORT_HS_MODE
+    return ledc->num_channels > LEDC_CHANNELS_PER_GROUP;
+#else
+    return false;
+#endif
+}
+
+// Restart both timers together so the two groups share period boundaries.
+static void ledc_restart_timers(const servo_engine_ledc_t *ledc) {
+    ledc_timer_pause(LEDC_LOW_SPEED_MODE, LEDC_TIMER_0);
+    ledc_timer_rst(LEDC_LOW_SPEED_MODE, LEDC_TIMER_0);
+#if SOC_LEDC_SUPPORT_HS_MODE
+    if (ledc_uses_high_speed(ledc)) {
+        ledc_timer_pause(LEDC_HIGH_SPEED_MODE, LEDC_TIMER_0);
+        ledc_timer_rst(LEDC_HIGH_SPEED_MODE, LEDC_TIMER_0);
+        ledc_timer_resume(LEDC_HIGH_SPEED_MODE, LEDC_TIMER_0);
+    }
+#endif
+    ledc_timer_resume(LEDC_LOW_SPEED_MODE, LEDC_TIMER_0);
+}
+
+// Position of the low-speed timer in the current period. Both groups share
+// boundaries, so one counter covers the whole frame.
+static inline uint32_t ledc_timer_count(void) {
+    return LEDC.timer_group[LEDC_LOW_SPEED_MODE].timer[LEDC_TIMER_0].value.timer_cnt;
+}
+
+esp_err_t servo_engine_ledc_init(servo_engine_ledc_t *ledc, const gpio_num_t *gpios, uint8_t num_channels,
+                                 uint32_t freq_hz, ledc_timer_bit_t resolution) {
+    if (num_channels == 0 || num_channels > LEDC_ENGINE_CHANNELS) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    ledc->num_channels = num_channels;
+    ledc->period_counts = 1u << resolution;
+    uint64_t guard = (uint64_t)LEDC_LATCH_US_PER_CHANNEL * num_channels * freq_hz * ledc->period_counts / 1000000;
+    ledc->guard_counts = (uint32_t)guard + 1;
+    ledc->boundary_waits = 0;
+    ledc->split_bursts = 0;
+
+    // One timer per speed group; both run at the servo frame rate.
+    ledc_timer_config_t timer = {
+        .speed_mode = LEDC_LOW_SPEED_MODE,
+        .timer_num = LEDC_TIMER_0,
+        .freq_hz = freq_hz,
+        .duty_resolution = resolution,
+        .clk_cfg = LEDC_AUTO_CLK,
+    };
+    esp_err_t err = ledc_timer_config(&timer);
+    if (err != ESP_OK) {
+        return err;
+    }
+#if SOC_LEDC_SUPPORT_HS_MODE
+    if (ledc_uses_high_speed(ledc)) {
+        timer.speed_mode = LEDC_HIGH_SPEED_MODE;
+        err = ledc_timer_config(&timer);
+        if (err != ESP_OK) {
+            return err;
+        }
+    }
+#endif
+
+    for (uint8_t i = 0; i < num_channels; i++) {
+        ledc_channel_config_t channel = {
+            .gpio_num = gpios[i],
+            .speed_mode = ledc_mode_for(i),
+            .channel = ledc_channel_for(i),
+            .timer_sel = LEDC_TIMER_0,
+            .duty = 0,  // Start with a duty cycle of 0 to prevent unwanted movement.
+            .hpoint = 0,
+            .intr_type = LEDC_INTR_DISABLE,
+        };
+        err = ledc_channel_config(&channel);
+        if (err != ESP_OK) {
+            return err;
+        }
+    }
+
+    ledc_restart_timers(ledc);
+
+    return ledc_fade_func_install(0);
+}
+
+static void ledc_backend_set_duty(void *ctx, uint8_t index, uint32_t duty) {
+    ledc_set_duty(ledc_mode_for(index), ledc_channel_for(index), duty);
+}
+
+static void ledc_backend_prepare_fade(void *ctx, uint8_t index, uint32_t duty, uint32_t time_ms) {
+    ledc_set_fade_with_time(ledc_mode_for(index), ledc_channel_for(index), duty, time_ms);
+}
+
+// ledc_update_duty and ledc_fade_start take effect at the next period
+// boundary, so the burst only has to stay inside one period. If too little of
+// the period is left, wait (at most the guard time) for the boundary to pass.
+static void ledc_backend_latch_begin(void *ctx) {
+    servo_engine_ledc_t *ledc = ctx;
+    uint32_t count = ledc_timer_count();
+    if (ledc->period_counts - count < ledc->guard_counts) {
+        ledc->boundary_waits++;
+        uint32_t previous = count;
+        while ((count = ledc_timer_count()) >= previous) {
+            previous = count;
+        }
+    }
+    ledc->start_count = count;
+}
+
+static void ledc_backend_latch(void *ctx, uint8_t index, bool fade) {
+    if (fade) {
+        ledc_fade_start(ledc_mode_for(index), ledc_channel_for(index), LEDC_FADE_NO_WAIT);
+    } else {
+        ledc_update_duty(ledc_mode_for(index), ledc_channel_for(index));
+    }
+}
+
+static void ledc_backend_latch_end(void *ctx) {
+    servo_engine_ledc_t *ledc = ctx;
+    if (ledc_timer_count() < ledc->start_count) {
+        ledc->split_bursts++;  // Preempted or slower than the guard: part of the frame follows a period later.
+    }
+}
+
+static int64_t ledc_backend_now_us(void *ctx) {
+    return esp_timer_get_time();
+}
+
+servo_engine_backend_t servo_engine_ledc_backend(servo_engine_ledc_t *ledc) {
+    servo_engine_backend_t backend = {
+        .set_duty = ledc_backend_set_duty,
+        .prepare_fade = ledc_backend_prepare_fade,
+        .latch_begin = ledc_backend_latch_begin,
+        .latch = ledc_backend_latch,
+        .latch_end = ledc_backend_latch_end,
+        .now_us = ledc_backend_now_us,
+        .ctx = ledc,
+    };
+    return backend;
+}
+
+#endif
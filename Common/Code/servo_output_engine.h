@@ -0,0 +1,101 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+
+// Multi-servo output engine.
+//
+// The engine owns every PWM channel and accepts a whole frame of target duties
+// at once. Only channels whose target changed are written, long moves are
+// handed to the hardware fade unit instead of being stepped in software.
+//
+// All channels of a frame are staged first and then latched in one short
+// burst. The LEDC hardware applies a latched duty at the channel's next period
+// boundary, and the two speed groups' timers are restarted together at init,
+// so they share boundaries. Before the burst the LEDC backend reads the timer
+// counter; if less of the period is left than the burst may take, it waits
+// for the boundary to pass. Every channel of a frame therefore latches in the
+// same period and takes effect on the same boundary. The timers are never
+// paused, so no pulse is stretched.
+
+#define SERVO_ENGINE_MAX_CHANNELS 16  // 8 low-speed + 8 high-speed LEDC channels on the ESP32.
+
+// Register-level operations the engine needs. Channel indices 0..15 are
+// engine indices; the backend maps them onto speed modes and channels.
+typedef struct {
+    void (*set_duty)(void *ctx, uint8_t index, uint32_t duty);  // Stage a duty, takes effect on latch().
+    void (*prepare_fade)(void *ctx, uint8_t index, uint32_t duty, uint32_t time_ms);  // Program a hardware fade.
+    void (*latch_begin)(void *ctx);  // Start the latch burst.
+    void (*latch)(void *ctx, uint8_t index, bool fade);  // Apply the staged duty or start the programmed fade.
+    void (*latch_end)(void *ctx);  // End the latch burst.
+    int64_t (*now_us)(void *ctx);
+    void *ctx;
+} servo_engine_backend_t;
+
+typedef struct {
+    uint8_t num_channels;
+    uint32_t fade_threshold;  // Moves of at least this many duty counts use a hardware fade, 0 disables fades.
+    uint32_t fade_time_ms;  // Duration of a hardware fade.
+} servo_engine_config_t;
+
+typedef struct {
+    uint32_t frames;  // Frames applied.
+    uint32_t writes;  // Channels written with a direct duty update.
+    uint32_t fades;  // Channels moved with a hardware fade.
+    uint32_t unchanged;  // Channels skipped because the target did not change.
+    uint32_t deferred;  // Channels skipped because a fade was still running.
+    int64_t apply_us_total;  // Time spent in servo_engine_apply().
+    int64_t apply_us_max;
+} servo_engine_stats_t;
+
+typedef struct {
+    servo_engine_backend_t backend;
+    servo_engine_config_t config;
+    uint32_t duty[SERVO_ENGINE_MAX_CHANNELS];  // Duty each channel is at or fading towards.
+    int64_t fade_end_us[SERVO_ENGINE_MAX_CHANNELS];
+    servo_engine_stats_t stats;
+} servo_engine_t;
+
+void servo_engine_init(servo_engine_t *engine, const servo_engine_backend_t *backend, const servo_engine_config_t *config);
+
+// Apply one frame: targets holds one duty per configured channel. Returns the
+// number of channels that were written or started fading.
+uint8_t servo_engine_apply(servo_engine_t *engine, const uint16_t *targets);
+
+// Convert a pulse width to duty counts for the given PWM frequency and resolution.
+static inline uint32_t servo_engine_pulse_to_duty(uint32_t pulse_us, uint32_t freq_hz, uint8_t resolution_bits) {
+    return (uint32_t)((((uint64_t)pulse_us * freq_hz << resolution_bits) + 500000) / 1000000);
+}
+
+// Fake backend that counts register traffic instead of touching hardware, so
+// the engine can be exercised and timed on a Linux host.
+typedef struct {
+    uint32_t duty[SERVO_ENGINE_MAX_CHANNELS];
+    uint32_t register_writes;  // Approximate LEDC register writes the real backend would issue.
+    uint32_t latch_groups;  // latch_begin/latch_end pairs.
+    uint32_t unsynchronised_latches;  // Latches issued outside a latch burst (should stay 0).
+    bool in_burst;
+} servo_engine_fake_t;
+
+servo_engine_backend_t servo_engine_fake_backend(servo_engine_fake_t *fake);
+
+#ifdef ESP_PLATFORM
+#include "driver/gpio.h"
+#include "driver/ledc.h"
+#include "esp_err.h"
+
+// LEDC backend: engine channels 0-7 use the low-speed group, 8-15 the
+// high-speed group, each group driven by its own LEDC_TIMER_0.
+typedef struct {
+    uint8_t num_channels;
+    uint32_t period_counts;  // Timer counts per PWM period (2^resolution).
+    uint32_t guard_counts;  // Counts a latch burst over every channel may take.
+    uint32_t start_count;  // Timer count when the current burst started.
+    uint32_t boundary_waits;  // Bursts that waited for the next period.
+    uint32_t split_bursts;  // Bursts that still crossed a boundary (guard too small).
+} servo_engine_ledc_t;
+
+esp_err_t servo_engine_ledc_init(servo_engine_ledc_t *ledc, const gpio_num_t *gpios, uint8_t num_channels,
+                                 uint32_t freq_hz, ledc_timer_bit_t resolution);
+servo_engine_backend_t servo_engine_ledc_backend(servo_engine_ledc_t *ledc);
+#endif
@@ -0,0 +1,162 @@
+#include <string.h>
+#include "task_supervisor.h"
+
+#define RECORD_VERSION 1
+
+const uint32_t supervisor_class_budget_us[SUPERVISOR_CLASS_COUNT] = {
+    [SUPERVISOR_CLASS_FAST] = 50000,
+    [SUPERVISOR_CLASS_NORMAL] = 500000,
+    [SUPERVISOR_CLASS_SLOW] = 2000000,
+};
+
+static void seal_record(supervisor_t *sup) {
+    rtc_snapshot_seal(sup->record_header, sup->record, sizeof(*sup->record), RECORD_VERSION, sup->build_id);
+}
+
+void supervisor_init(supervisor_t *sup, supervisor_record_t *record, rtc_snapshot_t *record_header,
+                     uint32_t build_id, uint32_t cycles_per_us, bool stalled_by_watchdog) {
+    memset(sup, 0, sizeof(*sup));
+    sup->record = record;
+    sup->record_header = record_header;
+    sup->build_id = build_id;
+    sup->cycles_per_us = cycles_per_us ? cycles_per_us : 1;
+
+    if (rtc_snapshot_check(record_header, record, sizeof(*record), RECORD_VERSION, build_id) != RTC_SNAPSHOT_OK) {
+        memset(record, 0, sizeof(*record));
+        record->stalled_task = -1;
+    } else if (stalled_by_watchdog && record->stalled_task >= 0) {
+        record->stall_resets++;
+    }
+    record->boots++;
+    record->stalled_task = -1;
+    record->num_tasks = 0;  // Tasks register again and pick up their old entries by name.
+    seal_record(sup);
+}
+
+supervisor_slot_t *supervisor_register(supervisor_t *sup, const char *name, supervisor_class_t cls, int64_t now_us) {
+    if (sup->num_tasks >= SUPERVISOR_MAX_TASKS) {
+        return NULL;
+    }
+    uint8_t id = sup->num_tasks++;
+    sup->classes[id] = cls;
+    sup->last_beat_us[id] = now_us;
+
+    // Keep the history of a task that had the same slot before the reset.
+    supervisor_task_record_t *task = &sup->record->tasks[id];
+    if (strncmp(task->name, name, SUPERVISOR_NAME_LEN) != 0) {
+        memset(task, 0, sizeof(*task));
+        strncpy(task->name, name, SUPERVISOR_NAME_LEN - 1);
+    }
+    sup->record->num_tasks = sup->num_tasks;
+    seal_record(sup);
+    return &sup->slots[id];
+}
+
+bool supervisor_check(supervisor_t *sup, int64_t now_us) {
+    bool healthy = true;
+    bool changed = false;
+    int8_t stalled = -1;
+
+    for (uint8_t i = 0; i < sup->num_tasks; i++) {
+        supervisor_task_record_t *task = &sup->record->tasks[i];
+        uint32_t beats = __atomic_load_n(&sup->slots[i].beats, __ATOMIC_ACQUIRE);
+        if (beats != sup->seen_beats[i]) {
+            sup->seen_beats[i] = beats;
+            sup->last_beat_us[i] = now_us;
+            sup->late[i] = false;
+        } else if (now_us - sup->last_beat_us[i] > supervisor_class_budget_us[sup->classes[i]]) {
+            if (!sup->late[i]) {
+                sup->late[i] = true;  // Count each overrun once, however long it lasts.
+                task->missed++;
+                changed = true;
+            }
+            healthy = false;
+            stalled = stalled < 0 ? i : stalled;
+        }
+
+        uint32_t worst_us = __atomic_load_n(&sup->slots[i].worst_cycles, __ATOMIC_RELAXED) / sup->cycles_per_us;
+        if (worst_us > task->worst_us) {
+            task->worst_us = worst_us;
+            changed = true;
+        }
+    }
+
+    if (stalled != sup->record->stalled_task) {
+        sup->record->stalled_task = stalled;
+        changed = true;
+    }
+    if (changed) {
+        seal_record(sup);  // Before the feeding stops, so the reset finds it.
+    }
+    if (healthy) {
+        sup->feeds++;
+    } else {
+        sup->withheld++;
+    }
+    return healthy;
+}
+
+#ifdef ESP_PLATFORM
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "esp_log.h"
+#include "esp_task_wdt.h"
+#include "esp_timer.h"
+
+static const char *TAG = "supervisor";
+
+static void supervisor_task(void *arg) {
+    supervisor_t *sup = arg;
+    ESP_ERROR_CHECK(esp_task_wdt_add(NULL));
+
+    int8_t reported = -1;
+    TickType_t last_wake = xTaskGetTickCount();
+    for (;;) {
+        vTaskDelayUntil(&last_wake, pdMS_TO_TICKS(sup->period_ms));
+        if (supervisor_check(sup, esp_timer_get_time())) {
+            esp_task_wdt_reset();
+        }
+        // Log only when the stalled task changes, not on every pass
+        int8_t stalled = sup->record->stalled_task;
+        if (stalled != reported) {
+            if (stalled >= 0) {
+                ESP_LOGE(TAG, "%s missed its %lu ms budget, watchdog no longer fed", sup->record->tasks[stalled].name,
+                         supervisor_class_budget_us[sup->classes[stalled]] / 1000);
+            } else {
+                ESP_LOGI(TAG, "All tasks back within budget");
+            }
+            reported = stalled;
+        }
+    }
+}
+
+void supervisor_start(supervisor_t *sup, uint32_t period_ms, UBaseType_t priority) {
+    sup->period_ms = period_ms;
+    xTaskCreate(supervisor_task, "supervisor", 3072, sup, priority, NULL);
+}
+
+void supervisor_log_record(const supervisor_t *sup, const char *tag) {
+    const supervisor_record_t *record = sup->record;
+    ESP_LOGI(tag, "Supervisor: boot %lu, %lu stall resets, %lu checks fed, %lu withheld", record->boots,
+             record->stall_resets, sup->feeds, sup->withheld);
+    for (uint8_t i = 0; i < record->num_tasks; i++) {
+        const supervisor_task_record_t *task = &record->tasks[i];
+        ESP_LOGI(tag, "  %-11s budget %5lu ms, worst loop %7lu us, %lu missed", task->name,
+                 supervisor_class_budget_us[sup->classes[i]] / 1000, task->worst_us, task->missed);
+    }
+}
+
+#define BENCH_BEATS 1000
+
+void supervisor_benchmark(const char *tag) {
+    supervisor_slot_t slot = { 0 };
+    uint32_t start = esp_cpu_get_cycle_count();
+    for (int i = 0; i < BENCH_BEATS; i++) {
+        supervisor_heartbeat(&slot);
+    }
+    uint32_t cycles = esp_cpu_get_cycle_count() - start;
+    ESP_LOGI(tag, "Heartbeat: %lu cycles each (%d beats)", cycles / BENCH_BEATS, BENCH_BEATS);
+}
+
+#endif
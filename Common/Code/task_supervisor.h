@@ -0,0 +1,117 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "rtc_snapshot.h"
+
+#ifdef ESP_PLATFORM
+#include "freertos/FreeRTOS.h"
+#include "esp_cpu.h"
+#endif
+
+// Heartbeat supervisor in front of the task watchdog.
+//
+// Each real-time task registers with a deadline class and gets its own
+// heartbeat slot. The task beats once per loop iteration: one cycle-counter
+// read and a few stores to memory only it writes, with no lock and no call.
+// A single supervisor task polls the slots. It feeds the hardware task
+// watchdog (TWDT) only while every task has beaten within its class budget,
+// so one stalled task is noticed within its own budget and ends in a TWDT
+// reset instead of being hidden by the tasks that are still running.
+//
+// Per-task worst-case loop time and missed-deadline counts are kept in a
+// caller-provided record, sealed with rtc_snapshot after every change. Put it
+// in RTC_NOINIT_ATTR memory and it survives the reset that follows a stall.
+
+#define SUPERVISOR_MAX_TASKS 8
+#define SUPERVISOR_NAME_LEN 12
+
+typedef enum {
+    SUPERVISOR_CLASS_FAST,  // Sampling loops, 50 ms budget.
+    SUPERVISOR_CLASS_NORMAL,  // Bus and radio tasks, 500 ms budget.
+    SUPERVISOR_CLASS_SLOW,  // User interface and housekeeping, 2 s budget.
+    SUPERVISOR_CLASS_COUNT,
+} supervisor_class_t;
+
+extern const uint32_t supervisor_class_budget_us[SUPERVISOR_CLASS_COUNT];
+
+// Written only by the owning task. The cycle counter is per core, so the
+// task must be pinned to one core for the loop times to mean anything.
+typedef struct {
+    uint32_t beats;  // Published with release order; the supervisor watches it change.
+    uint32_t last_cycles;  // Cycle count at the previous beat.
+    uint32_t worst_cycles;  // Longest beat-to-beat interval (wraps after 2^32 cycles, ~17 s at 240 MHz).
+} supervisor_slot_t;
+
+static inline void supervisor_heartbeat_at(supervisor_slot_t *slot, uint32_t cycles) {
+    uint32_t interval = cycles - slot->last_cycles;
+    if (interval > slot->worst_cycles && slot->beats) {
+        __atomic_store_n(&slot->worst_cycles, interval, __ATOMIC_RELAXED);
+    }
+    slot->last_cycles = cycles;
+    __atomic_store_n(&slot->beats, slot->beats + 1, __ATOMIC_RELEASE);
+}
+
+#ifdef ESP_PLATFORM
+static inline void supervisor_heartbeat(supervisor_slot_t *slot) {
+    supervisor_heartbeat_at(slot, esp_cpu_get_cycle_count());
+}
+#endif
+
+// Persistent part, meant for RTC_NOINIT_ATTR memory.
+typedef struct {
+    char name[SUPERVISOR_NAME_LEN];
+    uint32_t worst_us;
+    uint32_t missed;  // Times the task went past its budget.
+} supervisor_task_record_t;
+
+typedef struct {
+    uint32_t boots;
+    uint32_t stall_resets;  // Boots that followed a stall the supervisor had detected.
+    int8_t stalled_task;  // Task whose miss stopped the feeding, -1 while all are in budget.
+    uint8_t num_tasks;
+    supervisor_task_record_t tasks[SUPERVISOR_MAX_TASKS];
+} supervisor_record_t;
+
+typedef struct {
+    supervisor_slot_t slots[SUPERVISOR_MAX_TASKS];
+    supervisor_class_t classes[SUPERVISOR_MAX_TASKS];
+    uint32_t seen_beats[SUPERVISOR_MAX_TASKS];  // Supervisor-side copies, no sharing.
+    int64_t last_beat_us[SUPERVISOR_MAX_TASKS];
+    bool late[SUPERVISOR_MAX_TASKS];
+    uint8_t num_tasks;
+    uint32_t cycles_per_us;
+    uint32_t period_ms;  // Set by supervisor_start().
+    uint32_t build_id;
+    supervisor_record_t *record;
+    rtc_snapshot_t *record_header;
+    uint32_t feeds;  // Checks that found every task in budget.
+    uint32_t withheld;  // Checks that did not.
+} supervisor_t;
+
+// Adopts the record if its header is valid for this build, otherwise starts a
+// fresh one. stalled_by_watchdog says whether this boot is a TWDT reset; if
+// the record names a stalled task, the boot is counted as a stall reset.
+void supervisor_init(supervisor_t *sup, supervisor_record_t *record, rtc_snapshot_t *record_header,
+                     uint32_t build_id, uint32_t cycles_per_us, bool stalled_by_watchdog);
+
+// Register before the supervisor starts checking. Returns NULL when full.
+supervisor_slot_t *supervisor_register(supervisor_t *sup, const char *name, supervisor_class_t cls, int64_t now_us);
+
+// One supervision pass. Returns true when every task is within budget and the
+// watchdog may be fed.
+bool supervisor_check(supervisor_t *sup, int64_t now_us);
+
+#ifdef ESP_PLATFORM
+
+// Run supervisor_check every period_ms from a task of its own, which is the
+// only one subscribed to the TWDT and feeds it while the check passes.
+void supervisor_start(supervisor_t *sup, uint32_t period_ms, UBaseType_t priority);
+
+void supervisor_log_record(const supervisor_t *sup, const char *tag);
+
+// Log the cost of one heartbeat in CPU cycles.
+void supervisor_benchmark(const char *tag);
+
+#endif
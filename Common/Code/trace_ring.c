@@ -0,0 +1,153 @@
+#include <string.h>
+#include "trace_ring.h"
+
+_Static_assert((TRACE_RING_CAPACITY & (TRACE_RING_CAPACITY - 1)) == 0, "TRACE_RING_CAPACITY must be a power of two");
+_Static_assert(sizeof(trace_record_t) == 16, "trace records are 16 bytes on the wire");
+
+#define TRACE_NAME_ENTRY(id, name) [id] = name,
+const char *const trace_event_names[TRACE_EVENT_COUNT] = { TRACE_EVENTS(TRACE_NAME_ENTRY) };
+#undef TRACE_NAME_ENTRY
+
+trace_ring_t trace_rings[TRACE_MAX_CORES];
+
+size_t trace_ring_drain(trace_ring_t *ring, trace_record_t *out, size_t max) {
+    uint32_t tail = ring->tail;
+    uint32_t available = __atomic_load_n(&ring->head, __ATOMIC_ACQUIRE) - tail;
+    size_t count = available < max ? available : max;
+    for (size_t i = 0; i < count; i++) {
+        out[i] = ring->records[(tail + i) & (TRACE_RING_CAPACITY - 1)];
+    }
+    __atomic_store_n(&ring->tail, tail + count, __ATOMIC_RELEASE);
+    return count;
+}
+
+static void put_le(uint8_t *bytes, uint32_t value, int size) {
+    for (int i = 0; i < size; i++) {
+        bytes[i] = value >> (8 * i);
+    }
+}
+
+static uint32_t get_le(const uint8_t *bytes, int size) {
+    uint32_t value = 0;
+    for (int i = 0; i < size; i++) {
+        value |= (uint32_t)bytes[i] << (8 * i);
+    }
+    return value;
+}
+
+size_t trace_format_line(char *line, size_t line_size, const trace_record_t *records, size_t count) {
+    static const char hex[] = "0123456789abcdef";
+    size_t len = 0;
+    if (line_size < 4) {
+        return 0;
+    }
+    memcpy(line, "#T ", 3);
+    len = 3;
+    size_t written = 0;
+    for (; written < count && len + 32 < line_size; written++) {
+        const trace_record_t *record = &records[written];
+        uint8_t bytes[16];
+        put_le(&bytes[0], record->id, 2);
+        bytes[2] = record->core;
+        bytes[3] = record->reserved;
+        put_le(&bytes[4], record->timestamp_us, 4);
+        put_le(&bytes[8], record->a, 4);
+        put_le(&bytes[12], record->b, 4);
+        for (int i = 0; i < 16; i++) {
+            line[len++] = hex[bytes[i] >> 4];
+            line[len++] = hex[bytes[i] & 0x0F];
+        }
+    }
+    line[len] = '\0';
+    return written;
+}
+
+static int hex_value(char c) {
+    if (c >= '0' && c <= '9') {
+        return c - '0';
+    }
+    if (c >= 'a' && c <= 'f') {
+        return c - 'a' + 10;
+    }
+    return -1;
+}
+
+size_t trace_parse_line(const char *line, trace_record_t *records, size_t max) {
+    // The monitor may prefix lines (colour codes, timestamps), so look for the marker.
+    const char *p = strstr(line, "#T ");
+    if (p == NULL) {
+        return 0;
+    }
+    p += 3;
+    size_t count = 0;
+    while (count < max) {
+        uint8_t bytes[16];
+        for (int i = 0; i < 16; i++) {
+            int hi = hex_value(p[2 * i]);
+            int lo = hi < 0 ? -1 : hex_value(p[2 * i + 1]);
+            if (lo < 0) {
+                return count;
+            }
+            bytes[i] = (uint8_t)(hi << 4 | lo);
+        }
+        p += 32;
+        trace_record_t *record = &records[count++];
+        record->id = get_le(&bytes[0], 2);
+        record->core = bytes[2];
+        record->reserved = bytes[3];
+        record->timestamp_us = get_le(&bytes[4], 4);
+        record->a = get_le(&bytes[8], 4);
+        record->b = get_le(&bytes[12], 4);
+    }
+    return count;
+}
+
+#ifdef ESP_PLATFORM
+
+#include <stdio.h>
+#include "freertos/task.h"
+#include "esp_sleep.h"
+#include "esp_system.h"
+
+static void drain_all(void) {
+    static trace_record_t batch[TRACE_LINE_RECORDS];
+    static char line[4 + TRACE_LINE_RECORDS * 32 + 1];
+    for (int core = 0; core < TRACE_MAX_CORES; core++) {
+        size_t count;
+        while ((count = trace_ring_drain(&trace_rings[core], batch, TRACE_LINE_RECORDS)) > 0) {
+            trace_format_line(line, sizeof(line), batch, count);
+            puts(line);
+        }
+    }
+}
+
+static void trace_drain_task(void *arg) {
+    uint32_t period_ms = (uint32_t)(uintptr_t)arg;
+    uint32_t reported[TRACE_MAX_CORES] = { 0 };
+    for (;;) {
+        vTaskDelay(pdMS_TO_TICKS(period_ms));
+        drain_all();
+        for (int core = 0; core < TRACE_MAX_CORES; core++) {
+            uint32_t dropped = __atomic_load_n(&trace_rings[core].dropped, __ATOMIC_RELAXED);
+            if (dropped != reported[core]) {
+                printf("trace: core %d dropped %lu records\n", core, dropped - reported[core]);
+                reported[core] = dropped;
+            }
+        }
+    }
+}
+
+void trace_start_drain_task(uint32_t period_ms, UBaseType_t priority) {
+    xTaskCreate(trace_drain_task, "trace_drain", 3072, (void *)(uintptr_t)period_ms, priority, NULL);
+}
+
+void trace_emit_boot(void) {
+    trace_emit(TRACE_BOOT, esp_reset_reason(), esp_sleep_get_wakeup_cause());
+}
+
+void trace_flush(void) {
+    drain_all();
+    fflush(stdout);
+}
+
+#endif
@@ -0,0 +1,124 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef ESP_PLATFORM
+#include "freertos/FreeRTOS.h"
+#include "esp_cpu.h"
+#include "esp_timer.h"
+#endif
+
+// Binary trace buffer for hot paths and interrupt handlers.
+//
+// Emitting a trace record stores 16 bytes in a ring owned by the calling core:
+// event id, esp_timer timestamp and two payload words. Nothing is formatted
+// and nothing waits for the UART. Each core has its own ring, so the two cores
+// never contend. Tasks and ISRs on the same core are serialised by masking
+// interrupts for the few stores a record takes. A full ring drops the new
+// record and counts it.
+//
+// A low-priority task drains both rings in bulk and prints the raw records as
+// "#T" hex lines. Capture the monitor output and feed it to the host decoder
+// (Common/Tools/trace_decode.c) to get a timeline, per-event interval
+// histograms and start-to-end latencies.
+
+#define TRACE_RING_CAPACITY 256  // Records per core, must be a power of two.
+#define TRACE_MAX_CORES 2
+#define TRACE_LINE_RECORDS 8  // Records per "#T" line.
+
+// Event ids used across the series. X(id, name) so the decoder can print names.
+#define TRACE_EVENTS(X) \
+    X(TRACE_ADC_BLOCK, "adc_block")  /* a: channel slot, b: cycles spent on the block */ \
+    X(TRACE_SERVO_UPDATE, "servo_update")  /* a: new duty, b: cycles spent mapping and writing */ \
+    X(TRACE_WDT_TICK, "wdt_tick")  /* a: counter value */ \
+    X(TRACE_WDT_PRESS, "wdt_press")  /* From the ISR. a: GPIO number */ \
+    X(TRACE_WDT_BUTTON, "wdt_button")  /* a: counter value, b: ISR-to-task latency in us */ \
+    X(TRACE_SLEEP_ENTER, "sleep_enter")  /* a: power manager state, b: limiting client */ \
+    X(TRACE_SLEEP_WAKE, "sleep_wake")  /* a: wake cause, b: state it woke from */ \
+    X(TRACE_SLEEP_BUTTON, "sleep_button")  /* a: LED colour chosen */ \
+    X(TRACE_BOOT, "boot")  /* First record of every boot. a: reset reason, b: wake-up cause */
+
+#define TRACE_ENUM_ENTRY(id, name) id,
+typedef enum {
+    TRACE_EVENTS(TRACE_ENUM_ENTRY)
+    TRACE_EVENT_COUNT,
+} trace_event_t;
+#undef TRACE_ENUM_ENTRY
+
+extern const char *const trace_event_names[TRACE_EVENT_COUNT];
+
+typedef struct {
+    uint16_t id;
+    uint8_t core;
+    uint8_t reserved;
+    uint32_t timestamp_us;  // Low 32 bits of esp_timer_get_time(); the decoder unwraps it.
+    uint32_t a;
+    uint32_t b;
+} trace_record_t;
+
+typedef struct {
+    trace_record_t records[TRACE_RING_CAPACITY];
+    uint32_t head;  // Written by the emitting core only, inside its interrupt mask.
+    uint32_t tail;  // Written by the drain task only.
+    uint32_t dropped;  // Records lost to a full ring, written by the emitting core only.
+} trace_ring_t;
+
+extern trace_ring_t trace_rings[TRACE_MAX_CORES];
+
+// Producer side without locking. The caller makes sure only one producer
+// touches the ring at a time (trace_emit does it by masking interrupts).
+// Forced inline like trace_emit, so the IRAM path stays free of flash calls.
+static inline __attribute__((always_inline)) bool trace_ring_put(trace_ring_t *ring, uint16_t id, uint8_t core,
+                                                                 uint32_t timestamp_us, uint32_t a, uint32_t b) {
+    uint32_t head = ring->head;
+    if (head - __atomic_load_n(&ring->tail, __ATOMIC_ACQUIRE) >= TRACE_RING_CAPACITY) {
+        __atomic_store_n(&ring->dropped, ring->dropped + 1, __ATOMIC_RELAXED);
+        return false;
+    }
+    trace_record_t *record = &ring->records[head & (TRACE_RING_CAPACITY - 1)];
+    record->id = id;
+    record->core = core;
+    record->reserved = 0;
+    record->timestamp_us = timestamp_us;
+    record->a = a;
+    record->b = b;
+    __atomic_store_n(&ring->head, head + 1, __ATOMIC_RELEASE);
+    return true;
+}
+
+// Consumer side: copy up to max records out in one go. Returns the count.
+size_t trace_ring_drain(trace_ring_t *ring, trace_record_t *out, size_t max);
+
+// Host decoder helpers. A "#T" line carries records as lowercase hex of their
+// 16 little-endian bytes. Returns the number of records parsed (0 if the line
+// is not a trace line).
+size_t trace_format_line(char *line, size_t line_size, const trace_record_t *records, size_t count);
+size_t trace_parse_line(const char *line, trace_record_t *records, size_t max);
+
+#ifdef ESP_PLATFORM
+
+// Safe from tasks and ISRs on either core. Forced inline so IRAM handlers do
+// not call into flash. The core id is read with interrupts masked: an unpinned
+// task could otherwise migrate after reading it and write the other core's
+// ring alongside that core's own producer.
+static inline __attribute__((always_inline)) void trace_emit(trace_event_t id, uint32_t a, uint32_t b) {
+    UBaseType_t mask = portSET_INTERRUPT_MASK_FROM_ISR();
+    uint32_t core = esp_cpu_get_core_id();
+    uint32_t timestamp = (uint32_t)esp_timer_get_time();
+    trace_ring_put(&trace_rings[core], id, core, timestamp, a, b);
+    portCLEAR_INTERRUPT_MASK_FROM_ISR(mask);
+}
+
+// Emit TRACE_BOOT. Call it first in app_main so the decoder starts a new
+// session there, even when the new boot's timestamps run on from the last.
+void trace_emit_boot(void);
+
+// Drain both rings every period_ms from a task at the given (low) priority.
+void trace_start_drain_task(uint32_t period_ms, UBaseType_t priority);
+
+// Drain and print everything now, e.g. right before deep sleep.
+void trace_flush(void);
+
+#endif
@@ -0,0 +1,29 @@
+#pragma once
+
+// Failure counting for the host tests in this directory. CHECK prints a
+// message for each condition that does not hold and carries on, so one run
+// reports every failure. main returns check_report().
+
+#include <stdint.h>
+#include <stdio.h>
+
+static uint32_t failures;
+
+#define CHECK(cond, ...)                  \
+    do {                                  \
+        if (!(cond)) {                    \
+            printf("FAIL: " __VA_ARGS__); \
+            printf("\n");                 \
+            failures++;                   \
+        }                                 \
+    } while (0)
+
+// Print the summary line and return the exit status: 1 if any check failed.
+static inline int check_report(void) {
+    if (failures) {
+        printf("%u checks failed\n", failures);
+        return 1;
+    }
+    printf("all checks passed\n");
+    return 0;
+}
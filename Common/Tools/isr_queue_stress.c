@@ -0,0 +1,167 @@
+// Two-thread host stress test for isr_queue.
+//
+// Build: gcc -O2 -pthread -I../Code -o isr_queue_stress isr_queue_stress.c ../Code/isr_queue.c
+// Usage: ./isr_queue_stress [events per run, default 100000]
+//
+// A producer thread stands in for the interrupt handler and pushes numbered,
+// timestamped events with isr_queue_push(). A consumer thread stands in for
+// the task: it sleeps on a semaphore that the producer posts after every push,
+// as isr_queue_push_and_notify() gives the task notification, then drains the
+// ring with isr_queue_wakeup() and isr_queue_pop(). The producer works in
+// bursts with a short sleep between them, like an interrupt source. The runs
+// cover short bursts the consumer keeps up with, bursts of twice the ring
+// size, a free-running producer racing the consumer, and a consumer that
+// pauses mid-drain. The consumer checks that event numbers only increase
+// and timestamps never go back. At the end, the popped events plus the
+// numbers skipped must equal the producer's accepted pushes plus its
+// drops. The drops must also match the overflow counter. The program
+// reports events/s and the host wake-up latency and exits non-zero on any
+// mismatch. Building with -fsanitize=thread also checks the atomics.
+
+#include <pthread.h>
+#include <semaphore.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include "isr_queue.h"
+
+static int64_t now_us(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+static void pause_us(long us) {
+    struct timespec ts = { .tv_sec = 0, .tv_nsec = us * 1000 };
+    nanosleep(&ts, NULL);
+}
+
+typedef struct {
+    isr_queue_t queue;
+    uint32_t events;
+    uint32_t burst;  // Pushes between producer pauses (0 = never pause).
+    uint32_t consumer_pause_every;  // Sleep after this many pops (0 = never).
+    sem_t notify;  // Stands in for the consumer's task notification.
+    bool done;
+
+    // Producer results.
+    uint32_t accepted;
+    uint32_t dropped;
+
+    // Consumer results.
+    uint32_t popped;
+    uint32_t skipped;  // Event numbers missing between consecutive pops.
+    uint32_t order_errors;
+} run_t;
+
+static void *producer(void *arg) {
+    run_t *run = arg;
+    for (uint32_t i = 0; i < run->events; i++) {
+        if (isr_queue_push(&run->queue, i, now_us())) {
+            run->accepted++;
+        } else {
+            run->dropped++;
+        }
+        sem_post(&run->notify);
+        if (run->burst && i % run->burst == run->burst - 1) {
+            pause_us(10);
+        }
+    }
+    __atomic_store_n(&run->done, true, __ATOMIC_RELEASE);
+    sem_post(&run->notify);
+    return NULL;
+}
+
+static void *consumer(void *arg) {
+    run_t *run = arg;
+    bool have_last = false;
+    isr_event_t last = { 0 };
+
+    while (true) {
+        // Wait, then clear the pending count, as ulTaskNotifyTake(pdTRUE, ...) does.
+        sem_wait(&run->notify);
+        while (sem_trywait(&run->notify) == 0) {
+        }
+        // Read the flag before draining, so nothing pushed before it is missed.
+        bool done = __atomic_load_n(&run->done, __ATOMIC_ACQUIRE);
+        isr_queue_wakeup(&run->queue);
+        isr_event_t event;
+        while (isr_queue_pop(&run->queue, &event, now_us())) {
+            if (have_last) {
+                if (event.value <= last.value || event.timestamp_us < last.timestamp_us) {
+                    run->order_errors++;
+                } else {
+                    run->skipped += event.value - last.value - 1;
+                }
+            } else {
+                run->skipped += event.value;
+            }
+            last = event;
+            have_last = true;
+            run->popped++;
+            if (run->consumer_pause_every && run->popped % run->consumer_pause_every == 0) {
+                pause_us(50);
+            }
+        }
+        if (done) {
+            break;
+        }
+    }
+    // Events dropped after the last one popped leave no gap behind them.
+    run->skipped += run->events - (have_last ? last.value + 1 : 0);
+    return NULL;
+}
+
+static uint32_t stress(const char *name, uint32_t events, uint32_t burst, uint32_t consumer_pause_every) {
+    static run_t run;
+    run = (run_t){
+        .events = events,
+        .burst = burst,
+        .consumer_pause_every = consumer_pause_every,
+    };
+    isr_queue_init(&run.queue);
+    sem_init(&run.notify, 0, 0);
+
+    pthread_t producer_thread, consumer_thread;
+    int64_t start = now_us();
+    pthread_create(&consumer_thread, NULL, consumer, &run);
+    pthread_create(&producer_thread, NULL, producer, &run);
+    pthread_join(producer_thread, NULL);
+    pthread_join(consumer_thread, NULL);
+    int64_t elapsed = now_us() - start;
+    isr_queue_wakeup(&run.queue);
+    sem_destroy(&run.notify);
+
+    const isr_queue_stats_t *stats = &run.queue.stats;
+    uint32_t errors = run.order_errors;
+    errors += run.accepted + run.dropped != events;
+    errors += run.popped != run.accepted || stats->popped != run.accepted || stats->pushed != run.accepted;
+    errors += run.skipped != run.dropped || stats->overflows != run.dropped;
+
+    printf("%-13s %9u events in %6.3f s (%5.1f M/s): %9lu popped, %9lu overflows (%lu skipped), %lu wake-ups, "
+           "latency p50 < %lld us, p99 < %lld us, max %lld us%s\n",
+           name, events, elapsed / 1e6, events / (double)elapsed, (unsigned long)stats->popped,
+           (unsigned long)stats->overflows, (unsigned long)run.skipped, (unsigned long)stats->wakeups,
+           (long long)isr_queue_latency_percentile(&run.queue, 0.5f),
+           (long long)isr_queue_latency_percentile(&run.queue, 0.99f), (long long)stats->latency_max_us,
+           errors ? "  <-- FAIL" : "");
+    if (run.order_errors) {
+        printf("  %u events out of order\n", run.order_errors);
+    }
+    return errors;
+}
+
+int main(int argc, char **argv) {
+    uint32_t events = argc > 1 ? (uint32_t)strtoul(argv[1], NULL, 0) : 100000;
+    uint32_t errors = 0;
+
+    errors += stress("short bursts", events, ISR_QUEUE_CAPACITY / 4, 0);
+    errors += stress("long bursts", events, ISR_QUEUE_CAPACITY * 2, 0);
+    errors += stress("free running", events * 10, 0, 0);
+    errors += stress("slow consumer", events, ISR_QUEUE_CAPACITY / 4, 100);
+
+    if (errors) {
+        printf("%u checks failed\n", errors);
+    }
+    return errors ? 1 : 0;
+}
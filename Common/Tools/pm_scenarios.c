@@ -0,0 +1,178 @@
+// Host scenario runner for the power manager on the simulated backend.
+//
+// Build: gcc -O2 -I../Code -o pm_scenarios pm_scenarios.c ../Code/power_manager.c
+// Usage: ./pm_scenarios [minutes per scenario, default 10]
+//
+// Replays the Sleep Modes loop against scripted button presses and light
+// sensor crossings. The clients are the same as on the device: blink (light
+// sleep at most while it has a deadline), button (ext0, 300 ms), light (ADC
+// threshold, polled within 10 s) and log (a 28 ms sampling burst every 10 s).
+// After a deep sleep the loop behaves like a fresh boot: a timer wake with
+// nothing new goes straight back to sleep, anything else blinks for 30 s.
+//
+// For each scenario it prints time, entries and energy per state, the
+// energy spent on the log bursts, the average power compared with never
+// sleeping, and the worst latency per event source. The program exits
+// non-zero if a deadline was missed, an event was never seen, or an event
+// took longer than its client's budget.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include "power_manager.h"
+
+#define LED_ON_TIME_US 400000
+#define LED_OFF_TIME_US 1600000
+#define ACTIVITY_WINDOW_US 30000000
+#define BUTTON_MAX_LATENCY_US 300000
+#define LIGHT_SENSOR_POLL_US 10000000
+#define LOG_INTERVAL_US 10000000
+#define LOG_BURST_US 28000  // 14 samples, 2 ms apart.
+
+#define S(seconds) ((int64_t)(seconds) * 1000000)
+
+typedef struct {
+    const char *name;
+    pm_sim_event_t events[PM_SIM_MAX_EVENTS];
+    uint8_t num_events;
+} scenario_t;
+
+typedef struct {
+    uint32_t count;
+    int64_t max_us;
+} latency_t;
+
+static void record(latency_t *latency, int64_t latency_us) {
+    latency->count++;
+    latency->max_us = latency_us > latency->max_us ? latency_us : latency->max_us;
+}
+
+static uint32_t run(const scenario_t *scenario, int64_t duration_us) {
+    static const char *names[PM_STATE_COUNT] = { "active", "light", "deep" };
+    static pm_sim_t sim;
+    static pm_t pm;
+    pm_backend_t backend = pm_sim_backend(&sim, scenario->events, scenario->num_events);
+    pm_init(&pm, &backend, NULL);
+    int blink = pm_register(&pm, "blink", 0, 0, PM_STATE_LIGHT_SLEEP);
+    pm_register(&pm, "button", PM_WAKE_EXT0, BUTTON_MAX_LATENCY_US, PM_STATE_DEEP_SLEEP);
+    pm_register(&pm, "light", PM_WAKE_ADC_THRESHOLD, LIGHT_SENSOR_POLL_US, PM_STATE_DEEP_SLEEP);
+    int log = pm_register(&pm, "log", 0, 0, PM_STATE_DEEP_SLEEP);
+
+    latency_t button = { 0 };
+    latency_t light = { 0 };
+    uint64_t work_nj = 0;
+    int64_t work_us = 0;
+    int64_t active_until = S(0);  // The first boot is a cold start with nothing to show.
+    int64_t next_log = 0;
+    int64_t next_toggle = 0;
+    bool led_on = false;
+
+    while (sim.clock_us < duration_us) {
+        int64_t now = sim.clock_us;
+        if (now >= next_log) {
+            sim.clock_us += LOG_BURST_US;  // Sampling keeps the CPU awake.
+            work_us += LOG_BURST_US;
+            work_nj += (uint64_t)LOG_BURST_US * pm.states[PM_STATE_ACTIVE].power_uw / 1000;
+            next_log = now + LOG_INTERVAL_US;
+            now = sim.clock_us;
+        }
+        pm_set_deadline(&pm, log, next_log);
+
+        if (now < active_until) {
+            if (now >= next_toggle) {
+                led_on = !led_on;
+                next_toggle = now + (led_on ? LED_ON_TIME_US : LED_OFF_TIME_US);
+            }
+            pm_set_deadline(&pm, blink, next_toggle);
+        } else {
+            led_on = false;
+            pm_set_deadline(&pm, blink, PM_NO_DEADLINE);
+        }
+
+        pm_decision_t decision = pm_decide(&pm, now);
+        pm_wake_t wake = pm_sleep(&pm);
+        now = sim.clock_us;
+
+        int64_t event_us;
+        bool activity = false;
+        if (wake.cause == PM_WAKE_EXT0) {
+            record(&button, now - wake.event_us);
+            activity = true;
+        }
+        while (pm_sim_take(&sim, PM_WAKE_ADC_THRESHOLD, &event_us)) {
+            record(&light, now - event_us);
+            pm_record_latency(&pm, event_us);
+            activity = true;
+        }
+        if (activity) {
+            active_until = now + ACTIVITY_WINDOW_US;
+        } else if (decision.state == PM_STATE_DEEP_SLEEP) {
+            active_until = now;  // A fresh boot from a routine timer wake goes straight back to sleep.
+        }
+        if (decision.state == PM_STATE_DEEP_SLEEP) {
+            led_on = false;  // RAM is lost; the next blink starts over.
+            next_toggle = now;
+        }
+    }
+
+    const pm_stats_t *stats = &pm.stats;
+    uint64_t total_nj = work_nj;  // Log bursts happen outside pm_sleep().
+    for (int state = 0; state < PM_STATE_COUNT; state++) {
+        total_nj += stats->energy_nj[state];
+    }
+    uint32_t average_uw = (uint32_t)(total_nj * 1000 / sim.clock_us);
+    uint32_t never_sleep_uw = pm.states[PM_STATE_ACTIVE].power_uw;
+
+    uint8_t button_events = 0;
+    uint8_t light_events = 0;
+    for (uint8_t i = 0; i < scenario->num_events; i++) {
+        button_events += scenario->events[i].source == PM_WAKE_EXT0 && scenario->events[i].time_us < sim.clock_us;
+        light_events += scenario->events[i].source == PM_WAKE_ADC_THRESHOLD && scenario->events[i].time_us < sim.clock_us;
+    }
+    uint32_t errors = stats->deadline_misses;
+    errors += button.count != button_events || button.max_us > BUTTON_MAX_LATENCY_US;
+    errors += light.count != light_events || light.max_us > LIGHT_SENSOR_POLL_US;
+
+    printf("%s (%.0f s simulated)\n", scenario->name, sim.clock_us / 1e6);
+    for (int state = 0; state < PM_STATE_COUNT; state++) {
+        printf("  %-6s %6lu entries %9.1f s %10.1f mJ\n", names[state], (unsigned long)stats->entries[state],
+               stats->time_us[state] / 1e6, stats->energy_nj[state] / 1e6);
+    }
+    printf("  log bursts %14s %9.1f s %10.1f mJ\n", "", work_us / 1e6, work_nj / 1e6);
+    printf("  total %.1f mJ, average %lu uW (%.1f%% of never sleeping), %lu deadline misses\n", total_nj / 1e6,
+           (unsigned long)average_uw, 100.0 * average_uw / never_sleep_uw, (unsigned long)stats->deadline_misses);
+    printf("  button: %lu/%u presses, worst %lld ms (budget %d); light: %lu/%u crossings, worst %lld ms (budget %d)%s\n",
+           (unsigned long)button.count, button_events, (long long)button.max_us / 1000, BUTTON_MAX_LATENCY_US / 1000,
+           (unsigned long)light.count, light_events, (long long)light.max_us / 1000, LIGHT_SENSOR_POLL_US / 1000,
+           errors ? "  <-- FAIL" : "");
+    return errors;
+}
+
+int main(int argc, char **argv) {
+    int64_t minutes = argc > 1 ? strtol(argv[1], NULL, 0) : 10;
+    int64_t duration_us = minutes * S(60);
+
+    static scenario_t scenarios[4] = {
+        { .name = "idle: no events" },
+        { .name = "button pressed every 2 minutes" },
+        { .name = "light sensor crossing every 90 s" },
+        { .name = "busy: button every 20 s" },
+    };
+    for (int64_t t = S(60); t < duration_us && scenarios[1].num_events < PM_SIM_MAX_EVENTS; t += S(120)) {
+        scenarios[1].events[scenarios[1].num_events++] = (pm_sim_event_t){ t, PM_WAKE_EXT0 };
+    }
+    for (int64_t t = S(45); t < duration_us && scenarios[2].num_events < PM_SIM_MAX_EVENTS; t += S(90)) {
+        scenarios[2].events[scenarios[2].num_events++] = (pm_sim_event_t){ t, PM_WAKE_ADC_THRESHOLD };
+    }
+    for (int64_t t = S(5) + 123456; t < duration_us && scenarios[3].num_events < PM_SIM_MAX_EVENTS; t += S(20)) {
+        scenarios[3].events[scenarios[3].num_events++] = (pm_sim_event_t){ t, PM_WAKE_EXT0 };
+    }
+
+    uint32_t errors = 0;
+    for (size_t i = 0; i < sizeof(scenarios) / sizeof(scenarios[0]); i++) {
+        errors += run(&scenarios[i], duration_us);
+    }
+    if (errors) {
+        printf("%u checks failed\n", errors);
+    }
+    return errors ? 1 : 0;
+}
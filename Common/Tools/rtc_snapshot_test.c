@@ -0,0 +1,184 @@
+// Host test for rtc_snapshot's checks and the resume-time bookkeeping.
+//
+// Build: gcc -O2 -I../Code -o rtc_snapshot_test rtc_snapshot_test.c ../Code/rtc_snapshot.c
+// Usage: ./rtc_snapshot_test
+//
+// Checks that:
+//   - the CRC-32 matches the IEEE check value for "123456789",
+//   - a zeroed or invalidated header is EMPTY,
+//   - a header sealed by another build is OTHER_BUILD, and one sealed with
+//     another version or length is OTHER_LAYOUT,
+//   - flipping any single bit of the payload or of the sealed header fields
+//     makes it CORRUPT (or the more specific status the flipped field gives),
+//   - a sealed payload checks OK, stays OK after resealing, and the seal
+//     count rises until the header is invalidated,
+//   - rtc_resume_record keeps cold and warm apart and adds up the setup time.
+
+#include <stdio.h>
+#include <string.h>
+#include "host_check.h"
+#include "rtc_snapshot.h"
+
+#define BUILD_ID 0x1234ABCD
+#define VERSION 2
+
+// Shaped like an application payload: mixed field sizes and some padding.
+typedef struct {
+    uint32_t threshold_mv;
+    uint8_t flags;
+    uint16_t seq;
+    int64_t next_ms;
+    uint8_t table[37];
+} payload_t;
+
+static void fill(payload_t *p) {
+    memset(p, 0, sizeof(*p));  // Padding is sealed too, so keep it defined.
+    p->threshold_mv = 1830;
+    p->flags = 0x05;
+    p->seq = 412;
+    p->next_ms = 123456789;
+    for (size_t i = 0; i < sizeof(p->table); i++) {
+        p->table[i] = (uint8_t)(i * 7);
+    }
+}
+
+static rtc_snapshot_status_t check(const rtc_snapshot_t *snap, const payload_t *p) {
+    return rtc_snapshot_check(snap, p, sizeof(*p), VERSION, BUILD_ID);
+}
+
+static void test_crc(void) {
+    uint32_t crc = rtc_snapshot_crc32(0, "123456789", 9);
+    CHECK(crc == 0xCBF43926, "CRC-32 of \"123456789\" is %08X", crc);
+    // Feeding the data in two parts gives the same result.
+    crc = rtc_snapshot_crc32(rtc_snapshot_crc32(0, "1234", 4), "56789", 5);
+    CHECK(crc == 0xCBF43926, "split CRC-32 is %08X", crc);
+}
+
+static void test_rejections(void) {
+    rtc_snapshot_t snap;
+    payload_t p;
+    fill(&p);
+
+    memset(&snap, 0, sizeof(snap));
+    CHECK(check(&snap, &p) == RTC_SNAPSHOT_EMPTY, "zeroed header: %s", rtc_snapshot_status_name(check(&snap, &p)));
+
+    rtc_snapshot_seal(&snap, &p, sizeof(p), VERSION, BUILD_ID + 1);
+    CHECK(check(&snap, &p) == RTC_SNAPSHOT_OTHER_BUILD, "other build: %s", rtc_snapshot_status_name(check(&snap, &p)));
+
+    rtc_snapshot_seal(&snap, &p, sizeof(p), VERSION + 1, BUILD_ID);
+    CHECK(check(&snap, &p) == RTC_SNAPSHOT_OTHER_LAYOUT, "other version: %s",
+          rtc_snapshot_status_name(check(&snap, &p)));
+
+    rtc_snapshot_seal(&snap, &p, sizeof(p) - 1, VERSION, BUILD_ID);
+    CHECK(check(&snap, &p) == RTC_SNAPSHOT_OTHER_LAYOUT, "other length: %s",
+          rtc_snapshot_status_name(check(&snap, &p)));
+
+    rtc_snapshot_seal(&snap, &p, sizeof(p), VERSION, BUILD_ID);
+    CHECK(check(&snap, &p) == RTC_SNAPSHOT_OK, "sealed: %s", rtc_snapshot_status_name(check(&snap, &p)));
+    rtc_snapshot_invalidate(&snap);
+    CHECK(check(&snap, &p) == RTC_SNAPSHOT_EMPTY, "invalidated: %s", rtc_snapshot_status_name(check(&snap, &p)));
+}
+
+static void test_bit_flips(void) {
+    rtc_snapshot_t snap;
+    payload_t p;
+    fill(&p);
+    memset(&snap, 0, sizeof(snap));
+    rtc_snapshot_seal(&snap, &p, sizeof(p), VERSION, BUILD_ID);
+
+    // Every bit of the payload.
+    uint32_t flips = 0;
+    uint8_t *bytes = (uint8_t *)&p;
+    for (size_t i = 0; i < sizeof(p); i++) {
+        for (int bit = 0; bit < 8; bit++) {
+            bytes[i] ^= 1u << bit;
+            rtc_snapshot_status_t status = check(&snap, &p);
+            CHECK(status == RTC_SNAPSHOT_CORRUPT, "payload byte %zu bit %d: %s", i, bit,
+                  rtc_snapshot_status_name(status));
+            bytes[i] ^= 1u << bit;
+            flips++;
+        }
+    }
+
+    // Every bit of the header up to the CRC. A flip in the magic, build id,
+    // version or length is caught by that field's own check first.
+    bytes = (uint8_t *)&snap;
+    for (size_t i = 0; i < offsetof(rtc_snapshot_t, crc) + sizeof(snap.crc); i++) {
+        rtc_snapshot_status_t expected = RTC_SNAPSHOT_CORRUPT;
+        if (i < offsetof(rtc_snapshot_t, build_id)) {
+            expected = RTC_SNAPSHOT_EMPTY;
+        } else if (i < offsetof(rtc_snapshot_t, version)) {
+            expected = RTC_SNAPSHOT_OTHER_BUILD;
+        } else if (i < offsetof(rtc_snapshot_t, seals)) {
+            expected = RTC_SNAPSHOT_OTHER_LAYOUT;
+        }
+        for (int bit = 0; bit < 8; bit++) {
+            bytes[i] ^= 1u << bit;
+            rtc_snapshot_status_t status = check(&snap, &p);
+            CHECK(status == expected, "header byte %zu bit %d: %s, expected %s", i, bit,
+                  rtc_snapshot_status_name(status), rtc_snapshot_status_name(expected));
+            bytes[i] ^= 1u << bit;
+            flips++;
+        }
+    }
+    CHECK(check(&snap, &p) == RTC_SNAPSHOT_OK, "snapshot not OK after undoing the flips");
+    printf("bit flips: %u single-bit changes to a %zu-byte payload and its header\n", flips, sizeof(p));
+}
+
+static void test_round_trip(void) {
+    rtc_snapshot_t snap;
+    payload_t p;
+    fill(&p);
+    memset(&snap, 0, sizeof(snap));
+
+    // One seal per simulated deep sleep, changing the state in between.
+    for (uint32_t sleep = 1; sleep <= 100; sleep++) {
+        p.seq++;
+        p.next_ms += 10000;
+        rtc_snapshot_seal(&snap, &p, sizeof(p), VERSION, BUILD_ID);
+        CHECK(check(&snap, &p) == RTC_SNAPSHOT_OK, "sleep %u: %s", sleep, rtc_snapshot_status_name(check(&snap, &p)));
+        CHECK(snap.seals == sleep, "sleep %u: %u seals counted", sleep, snap.seals);
+    }
+
+    // A write after sealing, as a reset in the middle of an update would leave it.
+    p.threshold_mv++;
+    CHECK(check(&snap, &p) == RTC_SNAPSHOT_CORRUPT, "write after sealing went unnoticed");
+
+    rtc_snapshot_invalidate(&snap);
+    rtc_snapshot_seal(&snap, &p, sizeof(p), VERSION, BUILD_ID);
+    CHECK(check(&snap, &p) == RTC_SNAPSHOT_OK && snap.seals == 1, "after invalidating: %s, %u seals",
+          rtc_snapshot_status_name(check(&snap, &p)), snap.seals);
+    CHECK(strcmp(rtc_snapshot_status_name((rtc_snapshot_status_t)99), "?") == 0, "unknown status has a name");
+}
+
+static void test_resume_record(void) {
+    rtc_resume_stats_t stats;
+    memset(&stats, 0, sizeof(stats));
+    rtc_resume_record(&stats, false, 700000, 640000);
+    rtc_resume_record(&stats, true, 40000, 0);
+    rtc_resume_record(&stats, true, 60000, 0);
+    rtc_resume_record(&stats, false, 720000, 650000);
+
+    const rtc_resume_path_t *cold = &stats.cold;
+    const rtc_resume_path_t *warm = &stats.warm;
+    CHECK(cold->count == 2 && warm->count == 2, "%u cold and %u warm boots", cold->count, warm->count);
+    CHECK(cold->total_us == 1420000 && cold->setup_total_us == 1290000 && cold->max_us == 720000 &&
+              cold->last_us == 720000,
+          "cold: total %lld, setup %lld, max %lld, last %lld", (long long)cold->total_us,
+          (long long)cold->setup_total_us, (long long)cold->max_us, (long long)cold->last_us);
+    CHECK(warm->total_us == 100000 && warm->setup_total_us == 0 && warm->max_us == 60000 && warm->last_us == 60000,
+          "warm: total %lld, setup %lld, max %lld, last %lld", (long long)warm->total_us,
+          (long long)warm->setup_total_us, (long long)warm->max_us, (long long)warm->last_us);
+    printf("resume: cold avg %lld us (%lld us without setup), warm avg %lld us\n",
+           (long long)(cold->total_us / cold->count), (long long)((cold->total_us - cold->setup_total_us) / cold->count),
+           (long long)(warm->total_us / warm->count));
+}
+
+int main(void) {
+    test_crc();
+    test_rejections();
+    test_bit_flips();
+    test_round_trip();
+    test_resume_record();
+    return check_report();
+}
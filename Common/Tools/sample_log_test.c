@@ -0,0 +1,207 @@
+// Host test for the sample_log encoder, ring and corruption handling.
+//
+// Build: gcc -O2 -I../Code -o sample_log_test sample_log_test.c ../Code/sample_log.c
+// Usage: ./sample_log_test
+//
+// Checks that:
+//   - records of slow, noisy, full-scale and constant signals decode to the
+//     samples that were encoded, and oversized records are refused,
+//   - appending many times the ring size wraps records across the end of the
+//     buffer, drops only the oldest ones, and reads back every record still
+//     held, in order, with the dropped and held counts adding up,
+//   - a partial flush releases only the records read,
+//   - a record length of 0, one below the header size, or one running past
+//     head makes sample_log_valid() fail and stops a read at that record, and
+//     an append that reaches it empties the ring instead of looping.
+// It also prints the encoded bytes per sample for each signal.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "host_check.h"
+#include "sample_log.h"
+
+#define BURST 14
+
+typedef uint16_t (*signal_fn)(uint32_t n);
+
+static uint16_t slow(uint32_t n) {
+    return (uint16_t)(2048 + (n % 400 < 200 ? n % 200 : 200 - n % 200) * 3);
+}
+
+static uint16_t noisy(uint32_t n) {
+    (void)n;
+    return (uint16_t)(1500 + rand() % 64);
+}
+
+static uint16_t full_scale(uint32_t n) {
+    return (n & 1) ? 4095 : 0;
+}
+
+static uint16_t constant(uint32_t n) {
+    (void)n;
+    return 1234;
+}
+
+static void test_round_trip(const char *name, signal_fn signal) {
+    uint32_t samples_total = 0;
+    uint32_t bytes_total = 0;
+    for (uint32_t record = 0; record < 1000; record++) {
+        uint16_t in[BURST];
+        for (uint32_t i = 0; i < BURST; i++) {
+            in[i] = signal(record * BURST + i);
+        }
+        uint8_t encoded[SAMPLE_LOG_MAX_RECORD];
+        size_t len = sample_log_encode(encoded, sizeof(encoded), record * 10000, 2, in, BURST);
+        CHECK(len >= SAMPLE_LOG_HEADER_SIZE, "%s record %u did not encode", name, record);
+
+        uint16_t out[BURST];
+        uint32_t time_ms;
+        uint16_t interval_ms;
+        size_t count = sample_log_decode(encoded, len, &time_ms, &interval_ms, out, BURST);
+        CHECK(count == BURST && time_ms == record * 10000 && interval_ms == 2, "%s record %u decoded to %zu samples",
+              name, record, count);
+        CHECK(memcmp(in, out, sizeof(in)) == 0, "%s record %u decoded to different values", name, record);
+        samples_total += BURST;
+        bytes_total += len;
+    }
+    printf("%-10s %4.2f bytes/sample (%u samples in %u bytes)\n", name, (double)bytes_total / samples_total,
+           samples_total, bytes_total);
+}
+
+static void test_limits(void) {
+    uint16_t in[SAMPLE_LOG_MAX_RECORD];
+    for (size_t i = 0; i < SAMPLE_LOG_MAX_RECORD; i++) {
+        in[i] = full_scale(i);
+    }
+    uint8_t encoded[SAMPLE_LOG_MAX_RECORD];
+    CHECK(sample_log_encode(encoded, sizeof(encoded), 0, 1, in, 0) == 0, "an empty record encoded");
+    CHECK(sample_log_encode(encoded, sizeof(encoded), 0, 1, in, SAMPLE_LOG_MAX_RECORD) == 0,
+          "a record past SAMPLE_LOG_MAX_RECORD encoded");
+    CHECK(sample_log_encode(encoded, SAMPLE_LOG_HEADER_SIZE + 1, 0, 1, in, 2) == 0,
+          "a record larger than its buffer encoded");
+
+    size_t len = sample_log_encode(encoded, sizeof(encoded), 0, 1, in, 3);
+    uint16_t out[3];
+    uint32_t time_ms;
+    uint16_t interval_ms;
+    CHECK(sample_log_decode(encoded, len - 1, &time_ms, &interval_ms, out, 3) == 0, "a short length decoded");
+    encoded[len - 1] |= 0x80;  // The last varint now runs off the end.
+    CHECK(sample_log_decode(encoded, len, &time_ms, &interval_ms, out, 3) == 0, "a truncated varint decoded");
+}
+
+// Read every record left in the log and check it continues the sequence.
+static uint32_t read_all(const sample_log_t *log, uint32_t first, uint32_t *cursor) {
+    uint32_t expected = first;
+    uint8_t record[SAMPLE_LOG_MAX_RECORD];
+    size_t len;
+    while ((len = sample_log_read(log, cursor, record, sizeof(record))) > 0) {
+        uint16_t out[BURST];
+        uint32_t time_ms;
+        uint16_t interval_ms;
+        size_t count = sample_log_decode(record, len, &time_ms, &interval_ms, out, BURST);
+        CHECK(count == BURST && time_ms == expected * 10000, "record %u read back as %u ms", expected, time_ms);
+        for (uint32_t i = 0; i < count; i++) {
+            CHECK(out[i] == slow(expected * BURST + i), "record %u sample %u is %u", expected, i, out[i]);
+        }
+        expected++;
+    }
+    return expected - first;
+}
+
+static void append_records(sample_log_t *log, uint32_t first, uint32_t n) {
+    for (uint32_t record = first; record < first + n; record++) {
+        uint16_t in[BURST];
+        for (uint32_t i = 0; i < BURST; i++) {
+            in[i] = slow(record * BURST + i);
+        }
+        CHECK(sample_log_append(log, record * 10000, 2, in, BURST), "record %u not appended", record);
+    }
+}
+
+static void test_wrap(void) {
+    static sample_log_t log;
+    sample_log_init(&log);
+    const uint32_t appended = 5000;  // About 50 times around the ring.
+    append_records(&log, 0, appended);
+
+    CHECK(sample_log_valid(&log), "log invalid after wrapping");
+    CHECK(sample_log_used(&log) <= SAMPLE_LOG_CAPACITY, "%zu bytes used", sample_log_used(&log));
+    uint32_t first = log.stats.dropped_records;
+    uint32_t cursor = sample_log_begin(&log);
+    uint32_t held = read_all(&log, first, &cursor);
+    CHECK(cursor == log.head, "reading stopped %u bytes before head", log.head - cursor);
+    CHECK(first + held == appended && log.stats.records == appended, "%u dropped + %u held != %u appended", first,
+          held, appended);
+    CHECK(log.stats.dropped_samples == first * BURST, "%u samples dropped in %u records", log.stats.dropped_samples,
+          first);
+    CHECK(log.stats.resets == 0, "%u resets on a clean log", log.stats.resets);
+    printf("wrap: %u records appended, %u dropped, %u held in %zu bytes\n", appended, first, held,
+           sample_log_used(&log));
+
+    // A flush that delivers only part of the log frees only that part.
+    cursor = sample_log_begin(&log);
+    uint8_t record[SAMPLE_LOG_MAX_RECORD];
+    for (int i = 0; i < 10; i++) {
+        sample_log_read(&log, &cursor, record, sizeof(record));
+    }
+    sample_log_release(&log, cursor);
+    cursor = sample_log_begin(&log);
+    CHECK(read_all(&log, first + 10, &cursor) == held - 10, "partial release lost records");
+    sample_log_release(&log, cursor);
+    CHECK(sample_log_used(&log) == 0, "%zu bytes left after a full release", sample_log_used(&log));
+}
+
+typedef enum { AT_TAIL, MID_RING, LAST_RECORD } corrupt_at_t;
+
+static void test_corrupt_length(const char *name, corrupt_at_t where, uint8_t bad_len) {
+    static sample_log_t log;
+    sample_log_init(&log);
+    append_records(&log, 0, 5000);  // Full, so every further append has to drop.
+    uint32_t pos = log.tail;
+    for (int i = 0; where != AT_TAIL && (where == LAST_RECORD || i < 20); i++) {
+        uint32_t next = pos + log.data[pos & (SAMPLE_LOG_CAPACITY - 1)];
+        if (next == log.head) {
+            break;
+        }
+        pos = next;
+    }
+    log.data[pos & (SAMPLE_LOG_CAPACITY - 1)] = bad_len;
+    CHECK(!sample_log_valid(&log), "%s: log still valid", name);
+
+    // Reading stops at the bad length instead of stepping past it.
+    uint32_t cursor = sample_log_begin(&log);
+    uint8_t record[SAMPLE_LOG_MAX_RECORD];
+    uint32_t reads = 0;
+    while (sample_log_read(&log, &cursor, record, sizeof(record)) > 0 && reads < 1000) {
+        reads++;
+    }
+    CHECK(cursor == pos, "%s: reading stopped at %u, bad length at %u", name, cursor, pos);
+
+    // Appending drops records up to the bad length, then empties the ring.
+    append_records(&log, 5000, 200);
+    CHECK(log.stats.resets == 1, "%s: %u resets, expected 1", name, log.stats.resets);
+    CHECK(sample_log_valid(&log), "%s: log invalid after the reset", name);
+    cursor = sample_log_begin(&log);
+    uint32_t first = 5200;
+    while (sample_log_read(&log, &cursor, record, sizeof(record)) > 0) {
+        first--;
+    }
+    cursor = sample_log_begin(&log);
+    CHECK(read_all(&log, first, &cursor) == 5200 - first && cursor == log.head, "%s: log unreadable after the reset",
+          name);
+}
+
+int main(void) {
+    srand(1);
+    test_round_trip("slow", slow);
+    test_round_trip("noisy", noisy);
+    test_round_trip("full scale", full_scale);
+    test_round_trip("constant", constant);
+    test_limits();
+    test_wrap();
+    test_corrupt_length("zero length at tail", AT_TAIL, 0);
+    test_corrupt_length("short length mid ring", MID_RING, SAMPLE_LOG_HEADER_SIZE - 1);
+    test_corrupt_length("length past head", LAST_RECORD, SAMPLE_LOG_MAX_RECORD);
+    return check_report();
+}
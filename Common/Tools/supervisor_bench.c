@@ -0,0 +1,194 @@
+// Host benchmark and check of the task supervisor's heartbeat and checks.
+//
+// Build: gcc -O2 -I../Code -o supervisor_bench supervisor_bench.c ../Code/task_supervisor.c ../Code/rtc_snapshot.c
+// Usage: ./supervisor_bench [heartbeats to time, default 100000000]
+//
+// Times supervisor_heartbeat_at() in a tight loop, as a task would call it
+// once per iteration, and reports ns per beat (and TSC ticks per beat on
+// x86). It then times one supervisor_check() pass over a full table of
+// tasks. Last, it replays the Watchdog example on a simulated clock: a 10 ms
+// FAST task and a SLOW task, checked every 20 ms. The FAST task stalls twice
+// and recovers once in between, then the supervisor is initialised again as
+// after a watchdog reset. The program checks that:
+//   - every check feeds while both tasks beat,
+//   - a stall is reported no later than its budget plus one check period,
+//   - a stall counts one miss however many checks find it late,
+//   - the record is sealed and names the stalled task when feeding stops,
+//   - the worst loop time includes the injected slow iteration,
+//   - after the reset the boot counts as a stall reset and the tasks keep
+//     their history by name,
+// and exits non-zero otherwise. The on-device cost in CPU cycles is logged
+// at start-up by supervisor_benchmark().
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include "host_check.h"
+#include "task_supervisor.h"
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#define HAVE_TSC 1
+#endif
+
+#define CYCLES_PER_US 240  // Simulated ESP32 clock.
+#define FAST_PERIOD_US 10000
+#define SLOW_PERIOD_US 1000000
+#define CHECK_PERIOD_US 20000
+#define BUILD_ID 0x1234ABCD
+
+static uint64_t now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000u + ts.tv_nsec;
+}
+
+static supervisor_t sup;
+static supervisor_record_t record;
+static rtc_snapshot_t header;
+
+static void bench_heartbeat(uint32_t beats) {
+    static supervisor_slot_t slot;
+    uint32_t cycles = 0;
+    uint64_t start = now_ns();
+#ifdef HAVE_TSC
+    uint64_t tsc_start = __rdtsc();
+#endif
+    for (uint32_t i = 0; i < beats; i++) {
+        cycles += 2400000;  // A 10 ms loop at 240 MHz.
+        supervisor_heartbeat_at(&slot, cycles);
+    }
+#ifdef HAVE_TSC
+    uint64_t tsc = __rdtsc() - tsc_start;
+#endif
+    uint64_t elapsed = now_ns() - start;
+    CHECK(slot.beats == beats, "%u beats published of %u", slot.beats, beats);
+    printf("heartbeat: %.2f ns/beat", (double)elapsed / beats);
+#ifdef HAVE_TSC
+    printf(", %.2f TSC ticks/beat", (double)tsc / beats);
+#endif
+    printf(" (%u beats)\n", beats);
+}
+
+static void bench_check(void) {
+    supervisor_init(&sup, &record, &header, BUILD_ID, CYCLES_PER_US, false);
+    supervisor_slot_t *slots[SUPERVISOR_MAX_TASKS];
+    for (int i = 0; i < SUPERVISOR_MAX_TASKS; i++) {
+        char name[SUPERVISOR_NAME_LEN];
+        snprintf(name, sizeof(name), "task%d", i);
+        slots[i] = supervisor_register(&sup, name, SUPERVISOR_CLASS_FAST, 0);
+    }
+    const uint32_t passes = 1000000;
+    uint64_t check_ns = 0;
+    uint32_t cycles = 0;
+    for (uint32_t pass = 0; pass < passes; pass++) {
+        cycles += CHECK_PERIOD_US * CYCLES_PER_US;
+        for (int i = 0; i < SUPERVISOR_MAX_TASKS; i++) {
+            supervisor_heartbeat_at(slots[i], cycles);
+        }
+        uint64_t t0 = now_ns();
+        supervisor_check(&sup, (int64_t)pass * CHECK_PERIOD_US);
+        check_ns += now_ns() - t0;
+    }
+    CHECK(sup.withheld == 0, "%u checks withheld with every task beating", sup.withheld);
+    printf("check: %.1f ns/pass over %d tasks\n", (double)check_ns / passes, SUPERVISOR_MAX_TASKS);
+}
+
+typedef struct {
+    supervisor_slot_t *fast;
+    supervisor_slot_t *slow;
+    int64_t next_fast_us;
+    int64_t next_slow_us;
+    int64_t next_check_us;
+    int64_t last_fast_beat_us;
+    int64_t first_withheld_us;  // First check that withheld, -1 if none yet.
+} sim_t;
+
+// Run the simulated tasks and checks up to to_us. The FAST task does not beat
+// while stalled.
+static void simulate(sim_t *sim, int64_t to_us, bool fast_stalled) {
+    while (true) {
+        int64_t next = sim->next_check_us;
+        next = !fast_stalled && sim->next_fast_us < next ? sim->next_fast_us : next;
+        next = sim->next_slow_us < next ? sim->next_slow_us : next;
+        if (next >= to_us) {
+            break;
+        }
+        uint32_t cycles = (uint32_t)(next * CYCLES_PER_US);
+        if (!fast_stalled && next == sim->next_fast_us) {
+            supervisor_heartbeat_at(sim->fast, cycles);
+            sim->last_fast_beat_us = next;
+            sim->next_fast_us += FAST_PERIOD_US;
+        } else if (next == sim->next_slow_us) {
+            supervisor_heartbeat_at(sim->slow, cycles);
+            sim->next_slow_us += SLOW_PERIOD_US;
+        } else {
+            bool fed = supervisor_check(&sup, next);
+            if (!fed && sim->first_withheld_us < 0) {
+                sim->first_withheld_us = next;
+            }
+            sim->next_check_us += CHECK_PERIOD_US;
+        }
+    }
+    if (fast_stalled) {
+        sim->next_fast_us = to_us;  // Resume on a fresh schedule.
+    }
+}
+
+static void test_stall_and_reset(void) {
+    rtc_snapshot_invalidate(&header);
+    supervisor_init(&sup, &record, &header, BUILD_ID, CYCLES_PER_US, false);
+    sim_t sim = { .first_withheld_us = -1, .next_check_us = CHECK_PERIOD_US };
+    sim.slow = supervisor_register(&sup, "main", SUPERVISOR_CLASS_SLOW, 0);
+    sim.fast = supervisor_register(&sup, "sampler", SUPERVISOR_CLASS_FAST, 0);
+    const uint32_t fast_budget = supervisor_class_budget_us[SUPERVISOR_CLASS_FAST];
+
+    // Healthy, then one slow iteration.
+    simulate(&sim, 5000000, false);
+    CHECK(sup.withheld == 0 && sim.first_withheld_us < 0, "%u checks withheld while healthy", sup.withheld);
+    sim.next_fast_us += 30000;  // One 40 ms iteration, still inside the budget.
+    simulate(&sim, 6000000, false);
+    CHECK(sup.withheld == 0, "a 40 ms iteration withheld feeding");
+    CHECK(record.tasks[1].worst_us >= 40000 && record.tasks[1].worst_us < 41000, "worst loop %u us, expected 40 ms",
+          record.tasks[1].worst_us);
+
+    // First stall: 2 s without a beat, then recovery.
+    simulate(&sim, 8000000, true);
+    int64_t detect_us = sim.first_withheld_us - sim.last_fast_beat_us;
+    CHECK(sim.first_withheld_us >= 0 && detect_us <= fast_budget + CHECK_PERIOD_US,
+          "stall reported %lld us after the last beat", (long long)detect_us);
+    CHECK(record.tasks[1].missed == 1, "%u misses counted for one stall", record.tasks[1].missed);
+    CHECK(record.stalled_task == 1, "record names task %d as stalled", record.stalled_task);
+    CHECK(rtc_snapshot_check(&header, &record, sizeof(record), 1, BUILD_ID) == RTC_SNAPSHOT_OK,
+          "record not sealed when feeding stopped");
+    printf("stall: reported %lld us after the last beat (budget %u us, check every %d us), %u checks withheld\n",
+           (long long)detect_us, fast_budget, CHECK_PERIOD_US, sup.withheld);
+
+    uint32_t withheld = sup.withheld;
+    simulate(&sim, 9000000, false);
+    CHECK(record.stalled_task == -1 && sup.withheld == withheld, "feeding did not resume after the task recovered");
+
+    // Second stall, then the reset the watchdog would cause.
+    simulate(&sim, 10000000, true);
+    CHECK(record.tasks[1].missed == 2 && record.stalled_task == 1, "second stall: %u misses, stalled task %d",
+          record.tasks[1].missed, record.stalled_task);
+    uint32_t worst_us = record.tasks[1].worst_us;
+
+    supervisor_init(&sup, &record, &header, BUILD_ID, CYCLES_PER_US, true);
+    supervisor_register(&sup, "main", SUPERVISOR_CLASS_SLOW, 0);
+    supervisor_register(&sup, "sampler", SUPERVISOR_CLASS_FAST, 0);
+    CHECK(record.boots == 2 && record.stall_resets == 1, "after the reset: boot %u, %u stall resets", record.boots,
+          record.stall_resets);
+    CHECK(record.tasks[1].missed == 2 && record.tasks[1].worst_us == worst_us, "sampler history lost over the reset");
+
+    // Another build must not adopt the record.
+    supervisor_init(&sup, &record, &header, BUILD_ID + 1, CYCLES_PER_US, true);
+    CHECK(record.boots == 1 && record.stall_resets == 0, "record adopted by another build");
+}
+
+int main(int argc, char **argv) {
+    uint32_t beats = argc > 1 ? (uint32_t)strtoul(argv[1], NULL, 0) : 100000000;
+    bench_heartbeat(beats);
+    bench_check();
+    test_stall_and_reset();
+    return check_report();
+}
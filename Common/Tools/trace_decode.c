@@ -0,0 +1,306 @@
+// Host-side decoder for the "#T" lines printed by trace_ring.
+//
+// Build: gcc -O2 -I../Code -o trace_decode trace_decode.c ../Code/trace_ring.c
+// Usage: idf.py monitor | tee capture.log, then
+//        ./trace_decode [-q] [-l START:END]... < capture.log
+//
+// Prints the records of both cores merged into one timeline, then a
+// power-of-two histogram of the interval between consecutive records of each
+// event. Every -l START:END pair adds a latency histogram from each START
+// record to the next END record, e.g. -l wdt_press:wdt_button for the
+// ISR-to-task latency in the Watchdog example. -q leaves out the timeline.
+//
+// Every boot starts with a "boot" record (trace_emit_boot), which starts a new
+// session; intervals and latencies are never measured across sessions. This
+// matters after a short deep sleep, where the new boot's timestamps can carry
+// on above the last ones. Timestamps are the low 32 bits of
+// esp_timer_get_time(), so they wrap every 71 minutes. A step back near the
+// top of the range is taken as a wrap. Any other step back also starts a new
+// session, which covers captures from firmware without boot records.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "trace_ring.h"
+
+#define MAX_PAIRS 8
+#define HIST_BUCKETS 32  // Bucket 0 is < 1 us, bucket n is [2^(n-1), 2^n) us.
+
+typedef struct {
+    uint64_t time_us;  // Unwrapped.
+    uint32_t session;
+    uint32_t seq;  // Order in the capture, keeps the sort stable.
+    trace_record_t record;
+} event_t;
+
+typedef struct {
+    uint32_t count;
+    uint64_t min_us;
+    uint64_t max_us;
+    uint64_t sum_us;
+    uint32_t buckets[HIST_BUCKETS];
+} histogram_t;
+
+typedef struct {
+    int start;
+    int end;
+    histogram_t hist;
+} pair_t;
+
+static event_t *events;
+static size_t num_events;
+static size_t events_size;
+
+static int event_id(const char *name) {
+    for (int id = 0; id < TRACE_EVENT_COUNT; id++) {
+        if (strcmp(trace_event_names[id], name) == 0) {
+            return id;
+        }
+    }
+    char *end;
+    long id = strtol(name, &end, 0);  // Numeric ids work for events this build does not know.
+    return *end == '\0' && id >= 0 && id <= 0xFFFF ? (int)id : -1;
+}
+
+static const char *event_name(uint16_t id, char *buf, size_t size) {
+    if (id < TRACE_EVENT_COUNT) {
+        return trace_event_names[id];
+    }
+    snprintf(buf, size, "event_%u", id);
+    return buf;
+}
+
+static void hist_add(histogram_t *hist, uint64_t value_us) {
+    int bucket = 0;
+    while (bucket < HIST_BUCKETS - 1 && value_us >= (1ull << bucket)) {
+        bucket++;
+    }
+    hist->buckets[bucket]++;
+    if (hist->count == 0 || value_us < hist->min_us) {
+        hist->min_us = value_us;
+    }
+    if (value_us > hist->max_us) {
+        hist->max_us = value_us;
+    }
+    hist->sum_us += value_us;
+    hist->count++;
+}
+
+// Upper edge of the bucket holding the given percentile.
+static uint64_t hist_percentile(const histogram_t *hist, uint32_t percent) {
+    uint64_t target = ((uint64_t)hist->count * percent + 99) / 100;
+    uint64_t seen = 0;
+    for (int bucket = 0; bucket < HIST_BUCKETS; bucket++) {
+        seen += hist->buckets[bucket];
+        if (seen >= target) {
+            return 1ull << bucket;
+        }
+    }
+    return hist->max_us;
+}
+
+static void hist_print(const histogram_t *hist, const char *title) {
+    if (hist->count == 0) {
+        printf("%s: no samples\n\n", title);
+        return;
+    }
+    printf("%s: %u samples, min %llu us, avg %llu us, p50 < %llu us, p99 < %llu us, max %llu us\n", title, hist->count,
+           (unsigned long long)hist->min_us, (unsigned long long)(hist->sum_us / hist->count),
+           (unsigned long long)hist_percentile(hist, 50), (unsigned long long)hist_percentile(hist, 99),
+           (unsigned long long)hist->max_us);
+    uint32_t peak = 0;
+    for (int bucket = 0; bucket < HIST_BUCKETS; bucket++) {
+        peak = hist->buckets[bucket] > peak ? hist->buckets[bucket] : peak;
+    }
+    for (int bucket = 0; bucket < HIST_BUCKETS; bucket++) {
+        if (hist->buckets[bucket] == 0) {
+            continue;
+        }
+        char bar[41];
+        int len = (int)((uint64_t)hist->buckets[bucket] * 40 / peak);
+        len = len ? len : 1;
+        memset(bar, '#', len);
+        bar[len] = '\0';
+        printf("  %10llu - %-10llu us %8u  %s\n", bucket ? 1ull << (bucket - 1) : 0ull,
+               1ull << bucket, hist->buckets[bucket], bar);
+    }
+    printf("\n");
+}
+
+static void add_event(const trace_record_t *record) {
+    static uint32_t last_raw[TRACE_MAX_CORES];
+    static uint64_t epoch[TRACE_MAX_CORES];
+    static uint32_t session;
+    static int seen[TRACE_MAX_CORES];
+    static size_t session_start;  // Index of the first event in the current session.
+
+    int core = record->core < TRACE_MAX_CORES ? record->core : 0;
+    uint32_t raw = record->timestamp_us;
+    if (record->id == TRACE_BOOT) {
+        if (num_events > session_start) {
+            session++;
+        }
+        memset(epoch, 0, sizeof(epoch));
+        memset(seen, 0, sizeof(seen));
+        session_start = num_events;
+    } else if (seen[core] && raw < last_raw[core]) {
+        if (last_raw[core] >= 0xC0000000u && raw < 0x40000000u) {  // Top quarter to bottom quarter.
+            epoch[core] += 1ull << 32;
+        } else {
+            // The board was reset. Both cores start over.
+            session++;
+            memset(epoch, 0, sizeof(epoch));
+            memset(seen, 0, sizeof(seen));
+            session_start = num_events;
+        }
+    }
+    seen[core] = 1;
+    last_raw[core] = raw;
+
+    if (num_events == events_size) {
+        events_size = events_size ? events_size * 2 : 4096;
+        events = realloc(events, events_size * sizeof(*events));
+        if (events == NULL) {
+            fprintf(stderr, "trace_decode: out of memory\n");
+            exit(1);
+        }
+    }
+    event_t *event = &events[num_events];
+    event->time_us = epoch[core] + raw;
+    event->session = session;
+    event->seq = (uint32_t)num_events;
+    event->record = *record;
+    num_events++;
+}
+
+static int compare_events(const void *a, const void *b) {
+    const event_t *x = a;
+    const event_t *y = b;
+    if (x->session != y->session) {
+        return x->session < y->session ? -1 : 1;
+    }
+    if (x->time_us != y->time_us) {
+        return x->time_us < y->time_us ? -1 : 1;
+    }
+    return x->seq < y->seq ? -1 : x->seq > y->seq;
+}
+
+static void usage(void) {
+    fprintf(stderr, "usage: trace_decode [-q] [-l START:END]... < capture.log\n");
+    exit(2);
+}
+
+int main(int argc, char **argv) {
+    pair_t pairs[MAX_PAIRS];
+    int num_pairs = 0;
+    int quiet = 0;
+
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "-q") == 0) {
+            quiet = 1;
+        } else if (strcmp(argv[i], "-l") == 0 && i + 1 < argc && num_pairs < MAX_PAIRS) {
+            char spec[64];
+            snprintf(spec, sizeof(spec), "%s", argv[++i]);
+            char *colon = strchr(spec, ':');
+            if (colon == NULL) {
+                usage();
+            }
+            *colon = '\0';
+            pair_t *pair = &pairs[num_pairs++];
+            memset(pair, 0, sizeof(*pair));
+            pair->start = event_id(spec);
+            pair->end = event_id(colon + 1);
+            if (pair->start < 0 || pair->end < 0) {
+                fprintf(stderr, "trace_decode: unknown event in %s\n", argv[i]);
+                return 2;
+            }
+        } else {
+            usage();
+        }
+    }
+
+    static char line[4096];
+    trace_record_t records[sizeof(line) / 32];
+    size_t lines = 0;
+    while (fgets(line, sizeof(line), stdin) != NULL) {
+        size_t count = trace_parse_line(line, records, sizeof(records) / sizeof(records[0]));
+        for (size_t i = 0; i < count; i++) {
+            add_event(&records[i]);
+        }
+        lines += count > 0;
+    }
+    if (num_events == 0) {
+        fprintf(stderr, "trace_decode: no trace lines found\n");
+        return 1;
+    }
+    qsort(events, num_events, sizeof(*events), compare_events);
+
+    char name_buf[16];
+    if (!quiet) {
+        printf("%10s %10s %4s  %-14s %10s %10s\n", "time_us", "delta_us", "core", "event", "a", "b");
+        for (size_t i = 0; i < num_events; i++) {
+            const event_t *event = &events[i];
+            if (i > 0 && event->session != events[i - 1].session) {
+                printf("---- reset ----\n");
+            }
+            uint64_t delta = i > 0 && event->session == events[i - 1].session ? event->time_us - events[i - 1].time_us : 0;
+            printf("%10llu %10llu %4u  %-14s %10u %10u\n", (unsigned long long)event->time_us,
+                   (unsigned long long)delta, event->record.core,
+                   event_name(event->record.id, name_buf, sizeof(name_buf)), event->record.a, event->record.b);
+        }
+        printf("\n");
+    }
+    printf("%zu records from %zu lines\n\n", num_events, lines);
+
+    // Interval between consecutive records of the same event.
+    static uint8_t present[0x10000];
+    for (size_t i = 0; i < num_events; i++) {
+        present[events[i].record.id] = 1;
+    }
+    for (int id = 0; id <= 0xFFFF; id++) {
+        if (!present[id]) {
+            continue;
+        }
+        histogram_t hist = { 0 };
+        const event_t *prev = NULL;
+        for (size_t i = 0; i < num_events; i++) {
+            const event_t *event = &events[i];
+            if (event->record.id != id) {
+                continue;
+            }
+            if (prev != NULL && prev->session == event->session) {
+                hist_add(&hist, event->time_us - prev->time_us);
+            }
+            prev = event;
+        }
+        char title[64];
+        snprintf(title, sizeof(title), "%s interval", event_name(id, name_buf, sizeof(name_buf)));
+        hist_print(&hist, title);
+    }
+
+    // Start-to-end latency: each END closes the most recent open START.
+    for (int p = 0; p < num_pairs; p++) {
+        pair_t *pair = &pairs[p];
+        const event_t *open = NULL;
+        for (size_t i = 0; i < num_events; i++) {
+            const event_t *event = &events[i];
+            if (open != NULL && open->session != event->session) {
+                open = NULL;
+            }
+            if (event->record.id == pair->start) {
+                open = event;
+            } else if (event->record.id == pair->end && open != NULL) {
+                hist_add(&pair->hist, event->time_us - open->time_us);
+                open = NULL;
+            }
+        }
+        char start_buf[16];
+        char title[64];
+        snprintf(title, sizeof(title), "%s -> %s latency", event_name(pair->start, start_buf, sizeof(start_buf)),
+                 event_name(pair->end, name_buf, sizeof(name_buf)));
+        hist_print(&pair->hist, title);
+    }
+
+    free(events);
+    return 0;
+}
@@ -0,0 +1,189 @@
+// Host test for the trace ring and the "#T" line format.
+//
+// Build: gcc -O2 -I../Code -o trace_ring_test trace_ring_test.c ../Code/trace_ring.c
+// Usage: ./trace_ring_test [-c]
+//
+// Checks that:
+//   - records of every field width survive trace_format_line() and
+//     trace_parse_line() unchanged, for 1 to TRACE_LINE_RECORDS records per
+//     line, with the prefixes and colour codes idf.py monitor adds,
+//   - a line buffer too small for every record holds only whole records,
+//     and the parser returns exactly those,
+//   - ordinary log lines parse to nothing, and a line cut inside a record
+//     parses to the whole records before the cut,
+//   - a full ring drops and counts new records, and draining in odd-sized
+//     chunks over many wraps returns every kept record in order.
+// With -c it prints a synthetic Sleep Modes capture instead: three boots a
+// few hundred ms apart whose timestamps keep rising, as after a short deep
+// sleep. Pipe it into trace_decode to see one session per boot.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "host_check.h"
+#include "trace_ring.h"
+
+static uint32_t random_u32(void) {
+    return (uint32_t)rand() << 16 ^ (uint32_t)rand();
+}
+
+static trace_record_t random_record(void) {
+    trace_record_t record = {
+        .id = (uint16_t)random_u32(),
+        .core = (uint8_t)random_u32(),
+        .reserved = (uint8_t)random_u32(),
+        .timestamp_us = random_u32(),
+        .a = random_u32(),
+        .b = random_u32(),
+    };
+    return record;
+}
+
+static bool same(const trace_record_t *x, const trace_record_t *y) {
+    return x->id == y->id && x->core == y->core && x->reserved == y->reserved && x->timestamp_us == y->timestamp_us &&
+           x->a == y->a && x->b == y->b;
+}
+
+static void test_round_trip(void) {
+    static const char *const prefixes[] = { "", "I (1234) main: ", "\x1b[0;32m", "12:00:01.250 > " };
+    static const char *const suffixes[] = { "", "\n", "\x1b[0m\r\n" };
+    trace_record_t in[TRACE_LINE_RECORDS];
+    trace_record_t out[TRACE_LINE_RECORDS + 1];
+    char line[4 + TRACE_LINE_RECORDS * 32 + 1];  // The size the drain task uses.
+    char wrapped[sizeof(line) + 64];
+    uint32_t lines = 0;
+
+    for (int round = 0; round < 20000; round++) {
+        size_t count = 1 + round % TRACE_LINE_RECORDS;
+        for (size_t i = 0; i < count; i++) {
+            in[i] = random_record();
+        }
+        if (round == 0) {
+            memset(&in[0], 0xFF, sizeof(in[0]));  // Every field at its widest.
+        }
+        CHECK(trace_format_line(line, sizeof(line), in, count) == count, "round %d: %zu records did not fit", round,
+              count);
+        snprintf(wrapped, sizeof(wrapped), "%s%s%s", prefixes[round % 4], line, suffixes[round % 3]);
+        size_t parsed = trace_parse_line(wrapped, out, TRACE_LINE_RECORDS + 1);
+        CHECK(parsed == count, "round %d: %zu records parsed of %zu", round, parsed, count);
+        for (size_t i = 0; i < count && i < parsed; i++) {
+            CHECK(same(&in[i], &out[i]), "round %d: record %zu changed in transit", round, i);
+        }
+        lines++;
+    }
+    printf("round trip: %u lines, up to %d records each\n", lines, TRACE_LINE_RECORDS);
+}
+
+static void test_short_buffer(void) {
+    trace_record_t in[TRACE_LINE_RECORDS];
+    trace_record_t out[TRACE_LINE_RECORDS];
+    for (size_t i = 0; i < TRACE_LINE_RECORDS; i++) {
+        in[i] = random_record();
+    }
+    for (size_t size = 0; size < 4 + TRACE_LINE_RECORDS * 32 + 1; size++) {
+        char line[4 + TRACE_LINE_RECORDS * 32 + 1];
+        memset(line, 'x', sizeof(line));
+        size_t written = trace_format_line(line, size, in, TRACE_LINE_RECORDS);
+        size_t fits = size < 4 ? 0 : (size - 4) / 32;
+        CHECK(written == fits, "%zu-byte buffer took %zu records, expected %zu", size, written, fits);
+        if (size >= 4) {
+            CHECK(strlen(line) == 3 + written * 32, "%zu-byte buffer: line is %zu chars", size, strlen(line));
+            CHECK(trace_parse_line(line, out, TRACE_LINE_RECORDS) == written, "%zu-byte buffer: parse disagrees",
+                  size);
+        }
+    }
+}
+
+static void test_malformed(void) {
+    trace_record_t in[2] = { random_record(), random_record() };
+    trace_record_t out[2];
+    char line[4 + 2 * 32 + 1];
+    trace_format_line(line, sizeof(line), in, 2);
+
+    CHECK(trace_parse_line("I (100) main: Boot count 3", out, 2) == 0, "a log line parsed");
+    CHECK(trace_parse_line("#T", out, 2) == 0, "a bare marker parsed");
+    CHECK(trace_parse_line("", out, 2) == 0, "an empty line parsed");
+
+    for (size_t cut = 3; cut < strlen(line); cut++) {
+        char partial[sizeof(line)];
+        memcpy(partial, line, cut);
+        partial[cut] = '\0';
+        size_t parsed = trace_parse_line(partial, out, 2);
+        CHECK(parsed == (cut - 3) / 32, "line cut at %zu parsed to %zu records", cut, parsed);
+        CHECK(parsed == 0 || same(&in[0], &out[0]), "line cut at %zu changed the first record", cut);
+    }
+
+    char upper[sizeof(line)];
+    strcpy(upper, line);
+    upper[3 + 32 + 5] = 'A';  // Not the lowercase hex the formatter writes.
+    CHECK(trace_parse_line(upper, out, 2) == 1, "a bad digit in the second record was accepted");
+    CHECK(trace_parse_line(line, out, 1) == 1, "max was not respected");
+}
+
+static void test_ring(void) {
+    static trace_ring_t ring;
+    trace_record_t out[7];
+    uint32_t next_put = 0;
+    uint32_t next_get = 0;
+    uint32_t dropped = 0;
+
+    // Fill past capacity: the surplus is dropped, not overwritten.
+    for (uint32_t i = 0; i < TRACE_RING_CAPACITY + 10; i++) {
+        if (!trace_ring_put(&ring, 1, 0, next_put, next_put, 0)) {
+            dropped++;
+        }
+        next_put++;
+    }
+    CHECK(dropped == 10 && ring.dropped == 10, "%u dropped, ring counted %u", dropped, ring.dropped);
+    next_put = TRACE_RING_CAPACITY;  // The dropped ones never made it in.
+
+    // Put and drain at different paces over many wraps.
+    for (int round = 0; round < 100000; round++) {
+        for (int i = 0; i < round % 5; i++) {
+            if (trace_ring_put(&ring, 1, 0, next_put, next_put, 0)) {
+                next_put++;
+            }
+        }
+        size_t count = trace_ring_drain(&ring, out, 1 + round % 7);
+        for (size_t i = 0; i < count; i++) {
+            CHECK(out[i].a == next_get, "drained %u, expected %u", out[i].a, next_get);
+            next_get = out[i].a + 1;
+        }
+    }
+    while ((size_t)(trace_ring_drain(&ring, out, 7)) > 0) {
+    }
+    CHECK(ring.head == ring.tail, "%u records left", ring.head - ring.tail);
+    printf("ring: %u records through %d slots, %u dropped\n", ring.head, TRACE_RING_CAPACITY, ring.dropped);
+}
+
+// Three short boots of the Sleep Modes example, each flushed before deep
+// sleep. The timestamps keep rising from boot to boot.
+static void print_capture(void) {
+    uint32_t t = 180000;
+    char line[4 + TRACE_LINE_RECORDS * 32 + 1];
+    for (int boot = 0; boot < 3; boot++) {
+        trace_record_t records[4] = {
+            { .id = TRACE_BOOT, .timestamp_us = t, .a = 8, .b = 4 },  // Deep sleep reset, timer wake.
+            { .id = TRACE_SLEEP_ENTER, .timestamp_us = t + 20000, .a = 1, .b = 3 },
+            { .id = TRACE_SLEEP_WAKE, .timestamp_us = t + 120000, .a = 0, .b = 1 },
+            { .id = TRACE_SLEEP_ENTER, .timestamp_us = t + 125000, .a = 2, .b = 3 },
+        };
+        printf("I (%u) sleep: Boot %d\n", t / 1000, boot);
+        trace_format_line(line, sizeof(line), records, 4);
+        printf("%s\n", line);
+        t += 150000;  // Later than the last record, though the chip slept in between.
+    }
+}
+
+int main(int argc, char **argv) {
+    if (argc > 1 && strcmp(argv[1], "-c") == 0) {
+        print_capture();
+        return 0;
+    }
+    srand(1);
+    test_round_trip();
+    test_short_buffer();
+    test_malformed();
+    test_ring();
+    return check_report();
+}
@@ -5,14 +5,21 @@
 #include "driver/i2c.h"  // I2C driver for handling I2C communication.
 #include "driver/adc.h"  // ADC driver for handling analog-to-digital conversion.
 #include "driver/ledc.h"  // LEDC driver for handling PWM operations.
-#include "esp_adc_cal.h"  // Provides functionalities for ADC calibration.
+#include "servo_output_engine.h"  // Output engine that owns the LEDC timers and channels.
+#include "servo_duty_map.h"  // Raw-code-to-duty table shared with the ADC example.
+#include "i2c_frame.h"  // Framed, batched transport with sequence numbers and CRC.
+#include "isr_queue.h"  // Lock-free handoff from the button ISR to the master task.
 #include "esp_log.h"  // Logging library to output debugging information.
+#include "esp_timer.h"  // Timestamps for batched samples and recovery timing.
 // Define GPIO pins and I2C address for I2C communication
 #define I2C_MASTER_SCL_IO 22
 #define I2C_MASTER_SDA_IO 21
 #define I2C_SLAVE_SCL_IO 23
 #define I2C_SLAVE_SDA_IO 19
 #define I2C_SLAVE_ADDR 0X28
+#define I2C_MASTER_FREQ_HZ 100000
+#define I2C_TIMEOUT_MS 50  // Per-transaction timeout before a write counts as failed
+#define I2C_BATCH_WINDOW_MS 1000  // Send a partial batch once its oldest sample is this old
 
 // Define GPIO pin for button and ADC channel
 #define BUTTON_GPIO GPIO_NUM_33
@@ -20,25 +27,37 @@
 
 // Define GPIO pin for servo control and LEDC configurations
 #define SERVO_PIN GPIO_NUM_32
-#define LEDC_CHANNEL LEDC_CHANNEL_0
-#define LEDC_MODE LEDC_LOW_SPEED_MODE
-#define LEDC_TIMER LEDC_TIMER_0
-#define LEDC_FREQUENCY 50
-#define LEDC_RESOLUTION LEDC_TIMER_12_BIT
-
-// Declare variables for ADC operation and data handling
-static esp_adc_cal_characteristics_t *adc_chars;
-static volatile bool has_new_adc_value = false;
-static volatile uint32_t adc_value = 0;
-
-// ISR (Interrupt Service Routine) triggered by button press to update ADC value
+#define NUM_SERVOS 1
+// Pulse endpoints, PWM frequency and resolution live in servo_duty_map.h, as in the ADC example.
+#define SERVO_FADE_THRESHOLD 20  // Duty moves at least this large use a hardware fade
+#define SERVO_FADE_TIME_MS 300  // Duration of a hardware fade
+
+// Cores for the sampling (master) and consuming (slave) sides
+#define I2C_MASTER_CORE 0
+#define I2C_SLAVE_CORE 1
+
+static const char *TAG = "i2c";
+
+// Button presses travel from the ISR to the master task through this queue
+static isr_queue_t button_events;
+static TaskHandle_t master_task_handle;
+
+// Framed transport state for both ends
+static i2c_tx_t master_tx;
+static i2c_rx_t slave_rx;
+
+// Servo output engine driven by the I2C slave
+static const gpio_num_t servo_pins[NUM_SERVOS] = { SERVO_PIN };
+static servo_engine_ledc_t servo_ledc;
+static servo_engine_t servo_engine;
+
+// ISR (Interrupt Service Routine) triggered by button press; the ADC is read later by the master task
 static void IRAM_ATTR button_isr_handler(void* arg) {
-    adc_value = adc1_get_raw(ADC_CHANNEL);
-    has_new_adc_value = true;
+    isr_queue_push_and_notify(&button_events, master_task_handle, BUTTON_GPIO);
 }
 
-// Task executed by the I2C master
-static void i2c_master_task(void *arg) {
+// Configure and install the I2C master driver
+static esp_err_t i2c_master_setup(void) {
     // Configure I2C parameters for master mode
     i2c_config_t i2c_config = {
         .mode = I2C_MODE_MASTER,
@@ -46,25 +65,88 @@ static void i2c_master_task(void *arg) {
         .sda_pullup_en = GPIO_PULLUP_ENABLE,
         .scl_io_num = I2C_MASTER_SCL_IO,
         .scl_pullup_en = GPIO_PULLUP_ENABLE,
-        .master.clk_speed = 100000
+        .master.clk_speed = I2C_MASTER_FREQ_HZ
     };
-    ESP_ERROR_CHECK(i2c_param_config(I2C_NUM_0, &i2c_config));
-    ESP_ERROR_CHECK(i2c_driver_install(I2C_NUM_0, i2c_config.mode, 0, 0, 0));
+    esp_err_t err = i2c_param_config(I2C_NUM_0, &i2c_config);
+    if (err != ESP_OK) {
+        return err;
+    }
+    return i2c_driver_install(I2C_NUM_0, i2c_config.mode, 0, 0, 0);
+}
+
+// Link callbacks that connect the framed transport to the I2C master driver
+static bool i2c_link_write(void *ctx, const uint8_t *data, size_t len) {
+    return i2c_master_write_to_device(I2C_NUM_0, I2C_SLAVE_ADDR, data, len, pdMS_TO_TICKS(I2C_TIMEOUT_MS)) == ESP_OK;
+}
+
+static void i2c_link_recover(void *ctx) {
+    // Reinstalling the driver resets the controller state machine and clears a stuck bus
+    ESP_LOGW(TAG, "Recovering I2C bus");
+    i2c_driver_delete(I2C_NUM_0);
+    if (i2c_master_setup() != ESP_OK) {
+        ESP_LOGE(TAG, "I2C master reinstall failed");
+    }
+}
+
+static void i2c_link_delay_ms(void *ctx, uint32_t ms) {
+    vTaskDelay(pdMS_TO_TICKS(ms) ? pdMS_TO_TICKS(ms) : 1);
+}
+
+static int64_t i2c_link_now_us(void *ctx) {
+    return esp_timer_get_time();
+}
+
+// Task executed by the I2C master
+static void i2c_master_task(void *arg) {
+    ESP_ERROR_CHECK(i2c_master_setup());
+    i2c_link_t link = {
+        .write = i2c_link_write,
+        .recover = i2c_link_recover,
+        .delay_ms = i2c_link_delay_ms,
+        .now_us = i2c_link_now_us,
+    };
+    i2c_tx_init(&master_tx, &link);
+
+    // Samples collected since the last frame
+    i2c_sample_t batch[I2C_FRAME_MAX_SAMPLES];
+    uint8_t batch_len = 0;
 
-    uint8_t data[2];
     while (1) {
-        // Check if there's a new ADC value
-        if (has_new_adc_value) {
-            // Prepare data to be sent via I2C
-            data[0] = adc_value >> 8;
-            data[1] = adc_value & 0xFF;
-            // Write data to I2C slave device
-            ESP_ERROR_CHECK(i2c_master_write_to_device(I2C_NUM_0, I2C_SLAVE_ADDR, data, sizeof(data), 1000 / portTICK_PERIOD_MS));
-            // Reset flag after sending data
-            has_new_adc_value = false;
+        // Sleep until the ISR posts a button press, or until a partial batch is due
+        TickType_t wait = portMAX_DELAY;
+        if (batch_len > 0) {
+            uint32_t age_ms = (uint32_t)(esp_timer_get_time() / 1000) - batch[0].timestamp_ms;
+            wait = age_ms < I2C_BATCH_WINDOW_MS ? pdMS_TO_TICKS(I2C_BATCH_WINDOW_MS - age_ms) : 0;
+        }
+        ulTaskNotifyTake(pdTRUE, wait);
+        isr_queue_wakeup(&button_events);
+
+        // Drain every press that arrived since the last wake-up and read the ADC here, in task context
+        isr_event_t event;
+        int64_t now_us = esp_timer_get_time();
+        while (batch_len < I2C_FRAME_MAX_SAMPLES && isr_queue_pop(&button_events, &event, now_us)) {
+            batch[batch_len].timestamp_ms = (uint32_t)(event.timestamp_us / 1000);
+            batch[batch_len].value = adc1_get_raw(ADC_CHANNEL);
+            batch_len++;
+        }
+
+        // Send the batch as one frame when it is full or its oldest sample has waited long enough
+        uint32_t now_ms = (uint32_t)(esp_timer_get_time() / 1000);
+        if (batch_len == I2C_FRAME_MAX_SAMPLES || (batch_len > 0 && now_ms - batch[0].timestamp_ms >= I2C_BATCH_WINDOW_MS)) {
+            if (!i2c_tx_send(&master_tx, batch, batch_len)) {
+                ESP_LOGW(TAG, "Frame dropped after %d attempts (%lu dropped so far)", I2C_TX_MAX_ATTEMPTS, master_tx.stats.dropped);
+            } else {
+                ESP_LOGI(TAG, "Master: %lu frames, %lu bytes, %lu retries, %lu recoveries, last recovery %lld us",
+                         master_tx.stats.frames, master_tx.stats.bytes, master_tx.stats.retries,
+                         master_tx.stats.recoveries, master_tx.stats.recovery_us_last);
+            }
+            isr_queue_log_stats(&button_events, TAG);
+            batch_len = 0;
+            // Presses left in the queue belong to the next batch
+            if (isr_queue_pending(&button_events)) {
+                xTaskNotifyGive(master_task_handle);
+            }
         }
-        // Delay to stabilize readings
-        vTaskDelay(pdMS_TO_TICKS(100));
     }
 }
 
@@ -81,17 +163,41 @@ static void i2c_slave_task(void *arg) {
         .slave.slave_addr = I2C_SLAVE_ADDR
     };
     ESP_ERROR_CHECK(i2c_param_config(I2C_NUM_1, &i2c_config));
-    ESP_ERROR_CHECK(i2c_driver_install(I2C_NUM_1, i2c_config.mode, 512, 512, 0));
+    ESP_ERROR_CHECK(i2c_driver_install(I2C_NUM_1, i2c_config.mode, I2C_RX_RING_SIZE, I2C_RX_RING_SIZE, 0));
+    i2c_rx_init(&slave_rx);
 
-    uint8_t data[2];
+    uint32_t reported_errors = 0;
     while (1) {
-        // Read data from I2C master
-        int len = i2c_slave_read_buffer(I2C_NUM_1, data, sizeof(data), portMAX_DELAY);
-        if (len == 2) {
-            // Process ADC reading received from master and update LEDC
-            uint32_t adc_reading = (data[0] << 8) | data[1];
-            // Convert ADC reading to PWM duty cycle and update LEDC
-            // Note: Actual implementation depends on your application
+        // Read whatever the master sent straight into the free part of the receive ring
+        size_t space;
+        uint8_t *dst = i2c_rx_write_ptr(&slave_rx, &space);
+        if (space > 0) {
+            // A short timeout returns a partial read instead of waiting for the whole space to fill
+            int len = i2c_slave_read_buffer(I2C_NUM_1, dst, space, pdMS_TO_TICKS(I2C_TIMEOUT_MS));
+            if (len > 0) {
+                i2c_rx_commit(&slave_rx, len);
+            }
+        }
+
+        // Parse complete frames where they lie in the ring
+        i2c_frame_view_t frame;
+        while (i2c_rx_next(&slave_rx, &frame)) {
+            // Only the newest reading in a batch matters for the servo position
+            i2c_sample_t latest = i2c_frame_sample(&slave_rx, &frame, frame.count - 1);
+            // Look up the PWM duty for the raw ADC reading
+            uint16_t servo_frame[NUM_SERVOS] = { servo_duty_map[latest.value & SERVO_MAX_ADC_VALUE] };
+            // Readings arrive on button presses, so large jumps are smoothed by a hardware fade
+            servo_engine_apply(&servo_engine, servo_frame);
+            i2c_rx_consume(&slave_rx, &frame);
+        }
+
+        // Report link errors when they occur rather than on every frame
+        uint32_t errors = slave_rx.stats.crc_errors + slave_rx.stats.seq_gaps;
+        if (errors != reported_errors) {
+            ESP_LOGW(TAG, "Slave: %lu frames, %lu CRC errors, %lu lost frames, %lu duplicates, %lu resync bytes",
+                     slave_rx.stats.frames, slave_rx.stats.crc_errors, slave_rx.stats.seq_gaps,
+                     slave_rx.stats.duplicates, slave_rx.stats.resync_bytes);
+            reported_errors = errors;
         }
     }
 }
@@ -100,49 +206,40 @@ void app_main(void) {
     // Initialize ADC
     adc1_config_width(ADC_WIDTH_BIT_12);  // Set ADC width to 12 bits
     adc1_config_channel_atten(ADC_CHANNEL, ADC_ATTEN_DB_11);  // Configure ADC attenuation for the specified channel
-    adc_chars = calloc(1, sizeof(esp_adc_cal_characteristics_t));  // Allocate memory for ADC characteristics
-    esp_adc_cal_characterize(ADC_UNIT_1, ADC_ATTEN_DB_11, ADC_WIDTH_BIT_12, 1100, adc_chars);  // Initialize ADC calibration data
+    // Raw codes are sent to the slave for servo mapping, so no millivolt calibration is needed here
 
     // Initialize button interrupt
     gpio_set_direction(BUTTON_GPIO, GPIO_MODE_INPUT);  // Set button GPIO pin as input
     gpio_set_pull_mode(BUTTON_GPIO, GPIO_PULLUP_ONLY);  // Set pull-up resistor mode for button GPIO pin
     gpio_set_intr_type(BUTTON_GPIO, GPIO_INTR_POSEDGE);  // Configure button interrupt type as positive edge
-    gpio_install_isr_service(0);  // Install GPIO ISR service
-    gpio_isr_handler_add(BUTTON_GPIO, button_isr_handler, NULL);  // Add button ISR handler
 
-    // Initialize LEDC for servo control
-    ledc_timer_config_t ledc_timer = {
-        .speed_mode = LEDC_MODE,  // Set LEDC speed mode
-        .timer_num = LEDC_TIMER,  // Set LEDC timer number
-        .freq_hz = LEDC_FREQUENCY,  // Set PWM frequency
-        .duty_resolution = LEDC_RESOLUTION,  // Set PWM duty resolution
-        .clk_cfg = LEDC_AUTO_CLK,  // Use auto clock
+    // Initialize LEDC for servo control through the output engine
+    ESP_ERROR_CHECK(servo_engine_ledc_init(&servo_ledc, servo_pins, NUM_SERVOS, SERVO_PWM_FREQ_HZ, SERVO_PWM_RESOLUTION_BITS));  // Configure LEDC timers and channels for the duty table, duty starts at 0
+    servo_engine_backend_t servo_backend = servo_engine_ledc_backend(&servo_ledc);  // Route engine writes to the LEDC driver
+    servo_engine_config_t servo_config = {
+        .num_channels = NUM_SERVOS,  // Number of servos driven by the engine
+        .fade_threshold = SERVO_FADE_THRESHOLD,  // Use hardware fades for large moves
+        .fade_time_ms = SERVO_FADE_TIME_MS,  // Duration of each hardware fade
     };
-    ledc_timer_config(&ledc_timer);  // Configure LEDC timer
-
-    ledc_channel_config_t ledc_channel = {
-        .gpio_num = SERVO_PIN,  // Set GPIO pin for servo control
-        .speed_mode = LEDC_MODE,  // Set LEDC speed mode
-        .channel = LEDC_CHANNEL,  // Set LEDC channel
-        .timer_sel = LEDC_TIMER,  // Set LEDC timer
-        .duty = 0,  // Initialize PWM duty cycle to 0
-        .hpoint = 0,  // Initialize PWM hpoint to 0
-        .intr_type = LEDC_INTR_DISABLE,  // Disable LEDC interrupt
-    };
-    ledc_channel_config(&ledc_channel);  // Configure LEDC channel
+    servo_engine_init(&servo_engine, &servo_backend, &servo_config);  // Initialize the output engine
 
     // Start I2C tasks
-    xTaskCreate(i2c_master_task, "i2c_master_task", 2048, NULL, 10, NULL);  // Create I2C master task
-    xTaskCreate(i2c_slave_task, "i2c_slave_task", 2048, NULL, 11, NULL);  // Create I2C slave task
+    isr_queue_init(&button_events);  // Empty event queue before the ISR can fire
+    xTaskCreatePinnedToCore(i2c_master_task, "i2c_master_task", 2048, NULL, 10, &master_task_handle, I2C_MASTER_CORE);  // Create I2C master task on the sampling core
+    xTaskCreatePinnedToCore(i2c_slave_task, "i2c_slave_task", 2048, NULL, 11, NULL, I2C_SLAVE_CORE);  // Create I2C slave task on the consuming core
+
+    // The ISR notifies the master task, so attach it only once the task exists
+    gpio_install_isr_service(0);  // Install GPIO ISR service
+    gpio_isr_handler_add(BUTTON_GPIO, button_isr_handler, NULL);  // Add button ISR handler
 }
 
 
 // Essential Tips for I2C Communication
 // 1. Address Uniqueness: Ensure each I2C device on the bus has a unique address to avoid conflicts.
 // 2. Pull-up Resistors: Properly configure pull-up resistors on SDA and SCL lines for signal stability.
-// 3. Error Handling: Implement robust error checking to handle communication failures effectively.
+// 3. Error Handling: Retry, recover the bus and resynchronise on the next frame instead of aborting on a single NACK.
 // 4. Clock Speed: Optimize clock speed for reliable communication, balancing speed and signal integrity.
-// 5. Buffer Management: Manage data buffers efficiently to prevent overflow or underflow.
+// 5. Buffer Management: Keep ISRs short; queue the event and do the ADC read and bus traffic in a task.
 // 6. Testing: Thoroughly test communication under various conditions for reliability.
 // 7. Noise Reduction: Minimize noise interference by keeping bus lines short and isolated from noise sources.
 // 8. Documentation: Document device addresses and communication protocols for future reference.
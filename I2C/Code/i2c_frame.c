@@ -0,0 +1,288 @@
+#include <string.h>
+#include "i2c_frame.h"
+
+#define RING_MASK (I2C_RX_RING_SIZE - 1)
+
+_Static_assert((I2C_RX_RING_SIZE & RING_MASK) == 0, "I2C_RX_RING_SIZE must be a power of two");
+_Static_assert(I2C_FRAME_MAX_SIZE <= I2C_RX_RING_SIZE, "A frame must fit in the receive ring");
+
+static inline size_t frame_size(uint8_t count) {
+    return I2C_FRAME_HEADER_SIZE + (size_t)count * I2C_FRAME_SAMPLE_SIZE + I2C_FRAME_CRC_SIZE;
+}
+
+// CRC-16/CCITT-FALSE (poly 0x1021), one nibble at a time from a 16-entry table.
+static const uint16_t crc16_nibble[16] = {
+    0x0000, 0x1021, 0x2042, 0x3063, 0x4084, 0x50A5, 0x60C6, 0x70E7,
+    0x8108, 0x9129, 0xA14A, 0xB16B, 0xC18C, 0xD1AD, 0xE1CE, 0xF1EF,
+};
+
+uint16_t i2c_frame_crc16(uint16_t crc, const uint8_t *data, size_t len) {
+    for (size_t i = 0; i < len; i++) {
+        crc = (crc << 4) ^ crc16_nibble[(crc >> 12) ^ (data[i] >> 4)];
+        crc = (crc << 4) ^ crc16_nibble[(crc >> 12) ^ (data[i] & 0x0F)];
+    }
+    return crc;
+}
+
+static inline void put_u16(uint8_t *p, uint16_t v) {
+    p[0] = v & 0xFF;
+    p[1] = v >> 8;
+}
+
+size_t i2c_frame_encode(uint8_t *buf, size_t buf_size, uint8_t seq, const i2c_sample_t *samples, uint8_t count) {
+    if (count == 0 || count > I2C_FRAME_MAX_SAMPLES || buf_size < frame_size(count)) {
+        return 0;
+    }
+
+    uint32_t base_ms = samples[0].timestamp_ms;
+    buf[0] = I2C_FRAME_SOF0;
+    buf[1] = I2C_FRAME_SOF1;
+    buf[2] = seq;
+    buf[3] = count;
+    put_u16(&buf[4], base_ms & 0xFFFF);
+    put_u16(&buf[6], base_ms >> 16);
+
+    uint8_t *p = &buf[I2C_FRAME_HEADER_SIZE];
+    for (uint8_t i = 0; i < count; i++, p += I2C_FRAME_SAMPLE_SIZE) {
+        uint32_t offset = samples[i].timestamp_ms - base_ms;
+        if (offset > 0xFFFF) {
+            return 0;
+        }
+        put_u16(p, offset);
+        put_u16(p + 2, samples[i].value);
+    }
+
+    put_u16(p, i2c_frame_crc16(0xFFFF, &buf[2], p - &buf[2]));
+    return frame_size(count);
+}
+
+// ---------------------------------------------------------------------------
+// Receive side
+// ---------------------------------------------------------------------------
+
+static inline uint8_t ring_at(const i2c_rx_ring_t *ring, uint32_t pos) {
+    return ring->buf[pos & RING_MASK];
+}
+
+static inline uint16_t ring_u16(const i2c_rx_ring_t *ring, uint32_t pos) {
+    return ring_at(ring, pos) | (ring_at(ring, pos + 1) << 8);
+}
+
+// CRC over a span that may wrap around the end of the ring.
+static uint16_t ring_crc16(const i2c_rx_ring_t *ring, uint32_t pos, size_t len) {
+    size_t offset = pos & RING_MASK;
+    size_t first = len < I2C_RX_RING_SIZE - offset ? len : I2C_RX_RING_SIZE - offset;
+    uint16_t crc = i2c_frame_crc16(0xFFFF, &ring->buf[offset], first);
+    return i2c_frame_crc16(crc, ring->buf, len - first);
+}
+
+void i2c_rx_init(i2c_rx_t *rx) {
+    memset(rx, 0, sizeof(*rx));
+}
+
+uint8_t *i2c_rx_write_ptr(i2c_rx_t *rx, size_t *space) {
+    size_t free_bytes = I2C_RX_RING_SIZE - (rx->ring.head - rx->ring.tail);
+    size_t to_end = I2C_RX_RING_SIZE - (rx->ring.head & RING_MASK);
+    *space = free_bytes < to_end ? free_bytes : to_end;
+    return &rx->ring.buf[rx->ring.head & RING_MASK];
+}
+
+void i2c_rx_commit(i2c_rx_t *rx, size_t len) {
+    rx->ring.head += len;
+}
+
+bool i2c_rx_next(i2c_rx_t *rx, i2c_frame_view_t *view) {
+    i2c_rx_ring_t *ring = &rx->ring;
+
+    while (ring->head != ring->tail) {
+        uint32_t avail = ring->head - ring->tail;
+        uint32_t pos = ring->tail;
+
+        // Hunt for the two start-of-frame bytes.
+        if (ring_at(ring, pos) != I2C_FRAME_SOF0) {
+            ring->tail++;
+            rx->stats.resync_bytes++;
+            continue;
+        }
+        if (avail < 2) {
+            return false;
+        }
+        if (ring_at(ring, pos + 1) != I2C_FRAME_SOF1) {
+            ring->tail++;
+            rx->stats.resync_bytes++;
+            continue;
+        }
+        if (avail < I2C_FRAME_HEADER_SIZE) {
+            return false;
+        }
+
+        uint8_t count = ring_at(ring, pos + 3);
+        if (count == 0 || count > I2C_FRAME_MAX_SAMPLES) {
+            ring->tail++;
+            rx->stats.resync_bytes++;
+            continue;
+        }
+        size_t len = frame_size(count);
+        if (avail < len) {
+            return false;
+        }
+
+        uint16_t crc = ring_crc16(ring, pos + 2, len - 2 - I2C_FRAME_CRC_SIZE);
+        if (crc != ring_u16(ring, pos + len - I2C_FRAME_CRC_SIZE)) {
+            rx->stats.crc_errors++;
+            ring->tail++;
+            rx->stats.resync_bytes++;
+            continue;
+        }
+
+        // A retry after a lost acknowledgement repeats the previous frame.
+        uint8_t seq = ring_at(ring, pos + 2);
+        if (rx->have_seq && seq == rx->last_seq) {
+            rx->stats.duplicates++;
+            ring->tail += len;
+            continue;
+        }
+        if (rx->have_seq) {
+            rx->stats.seq_gaps += (uint8_t)(seq - rx->last_seq - 1);
+        }
+        rx->have_seq = true;
+        rx->last_seq = seq;
+
+        view->start = pos;
+        view->seq = seq;
+        view->count = count;
+        view->base_ms = ring_u16(ring, pos + 4) | ((uint32_t)ring_u16(ring, pos + 6) << 16);
+        return true;
+    }
+    return false;
+}
+
+i2c_sample_t i2c_frame_sample(const i2c_rx_t *rx, const i2c_frame_view_t *view, uint8_t index) {
+    uint32_t pos = view->start + I2C_FRAME_HEADER_SIZE + (uint32_t)index * I2C_FRAME_SAMPLE_SIZE;
+    i2c_sample_t sample = {
+        .timestamp_ms = view->base_ms + ring_u16(&rx->ring, pos),
+        .value = ring_u16(&rx->ring, pos + 2),
+    };
+    return sample;
+}
+
+void i2c_rx_consume(i2c_rx_t *rx, const i2c_frame_view_t *view) {
+    rx->ring.tail = view->start + frame_size(view->count);
+    rx->stats.frames++;
+    rx->stats.samples += view->count;
+}
+
+// ---------------------------------------------------------------------------
+// Transmit side
+// ---------------------------------------------------------------------------
+
+void i2c_tx_init(i2c_tx_t *tx, const i2c_link_t *link) {
+    memset(tx, 0, sizeof(*tx));
+    tx->link = *link;
+    tx->failing_since_us = -1;
+}
+
+bool i2c_tx_send(i2c_tx_t *tx, const i2c_sample_t *samples, uint8_t count) {
+    const i2c_link_t *link = &tx->link;
+    size_t len = i2c_frame_encode(tx->frame, sizeof(tx->frame), tx->seq, samples, count);
+    if (len == 0) {
+        tx->stats.dropped++;
+        return false;
+    }
+
+    for (uint8_t attempt = 0; attempt < I2C_TX_MAX_ATTEMPTS; attempt++) {
+        if (attempt > 0) {
+            tx->stats.retries++;
+            if (attempt == I2C_TX_MAX_ATTEMPTS - 1) {
+                link->recover(link->ctx);
+                tx->stats.recoveries++;
+            }
+            link->delay_ms(link->ctx, 1u << (attempt - 1));  // 1, 2, 4 ms backoff.
+        }
+
+        if (link->write(link->ctx, tx->frame, len)) {
+            if (tx->failing_since_us >= 0) {
+                int64_t recovery = link->now_us(link->ctx) - tx->failing_since_us;
+                tx->stats.recovery_us_last = recovery;
+                tx->stats.recovery_us_max = recovery > tx->stats.recovery_us_max ? recovery : tx->stats.recovery_us_max;
+                tx->failing_since_us = -1;
+            }
+            tx->stats.frames++;
+            tx->stats.bytes += len;
+            tx->seq++;
+            return true;
+        }
+        if (tx->failing_since_us < 0) {
+            tx->failing_since_us = link->now_us(link->ctx);
+        }
+    }
+
+    // Give up on this frame; skipping its sequence number shows the loss at the receiver.
+    tx->stats.dropped++;
+    tx->seq++;
+    return false;
+}
+
+// ---------------------------------------------------------------------------
+// Loopback stand-in
+// ---------------------------------------------------------------------------
+
+static void loopback_advance(i2c_loopback_t *loopback, size_t bytes) {
+    // Nine clocks per byte (eight data bits plus ACK), plus the address byte.
+    loopback->clock_us += (int64_t)(bytes + 1) * 9 * 1000000 / loopback->bus_hz;
+}
+
+static bool loopback_write(void *ctx, const uint8_t *data, size_t len) {
+    i2c_loopback_t *loopback = ctx;
+    loopback->writes++;
+
+    if (loopback->nack_every && loopback->writes % loopback->nack_every == 0) {
+        loopback_advance(loopback, 0);  // Address NACKed.
+        return false;
+    }
+
+    i2c_rx_t *rx = loopback->rx;
+    if (I2C_RX_RING_SIZE - (rx->ring.head - rx->ring.tail) < len) {
+        loopback_advance(loopback, 0);  // Slave buffer full, treated as a NACK.
+        return false;
+    }
+
+    for (size_t i = 0; i < len; i++) {
+        rx->ring.buf[(rx->ring.head + i) & RING_MASK] = data[i];
+    }
+    if (loopback->corrupt_every && loopback->writes % loopback->corrupt_every == 0) {
+        rx->ring.buf[(rx->ring.head + len / 2) & RING_MASK] ^= 0x10;
+    }
+    rx->ring.head += len;
+    loopback_advance(loopback, len);
+    return true;
+}
+
+static void loopback_recover(void *ctx) {
+    i2c_loopback_t *loopback = ctx;
+    loopback->clock_us += 100;  // Roughly what a FIFO reset and nine recovery clocks cost.
+}
+
+static void loopback_delay_ms(void *ctx, uint32_t ms) {
+    i2c_loopback_t *loopback = ctx;
+    loopback->clock_us += (int64_t)ms * 1000;
+}
+
+static int64_t loopback_now_us(void *ctx) {
+    i2c_loopback_t *loopback = ctx;
+    return loopback->clock_us;
+}
+
+i2c_link_t i2c_loopback_link(i2c_loopback_t *loopback, i2c_rx_t *rx, uint32_t bus_hz) {
+    memset(loopback, 0, sizeof(*loopback));
+    loopback->rx = rx;
+    loopback->bus_hz = bus_hz;
+    i2c_link_t link = {
+        .write = loopback_write,
+        .recover = loopback_recover,
+        .delay_ms = loopback_delay_ms,
+        .now_us = loopback_now_us,
+        .ctx = loopback,
+    };
+    return link;
+}
@@ -0,0 +1,142 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// Framed, batched transport between the I2C master and slave tasks.
+//
+// Frame layout (multi-byte fields little endian):
+//
+//   0   0xA5 0x5A         start of frame
+//   2   seq               sequence number, increments per new frame
+//   3   count             number of samples, 1..I2C_FRAME_MAX_SAMPLES
+//   4   base_ms (u32)     timestamp of the first sample
+//   8   count x { offset_ms (u16), value (u16) }
+//   n   crc16             CRC-16/CCITT-FALSE over bytes 2..n-1
+//
+// The receiver keeps a byte ring and parses frames where they lie, reading
+// fields through the ring index instead of copying a frame out first. A bad
+// header or CRC drops one byte and hunts for the next start of frame.
+
+#define I2C_FRAME_SOF0 0xA5
+#define I2C_FRAME_SOF1 0x5A
+#define I2C_FRAME_HEADER_SIZE 8
+#define I2C_FRAME_SAMPLE_SIZE 4
+#define I2C_FRAME_CRC_SIZE 2
+#define I2C_FRAME_MAX_SAMPLES 28  // Keeps a frame at 122 bytes, well inside the slave's buffer.
+#define I2C_FRAME_MAX_SIZE (I2C_FRAME_HEADER_SIZE + I2C_FRAME_MAX_SAMPLES * I2C_FRAME_SAMPLE_SIZE + I2C_FRAME_CRC_SIZE)
+
+typedef struct {
+    uint32_t timestamp_ms;
+    uint16_t value;
+} i2c_sample_t;
+
+uint16_t i2c_frame_crc16(uint16_t crc, const uint8_t *data, size_t len);
+
+// Encode up to I2C_FRAME_MAX_SAMPLES samples. Returns the frame length, or 0
+// if the samples do not fit (count, buffer size, or a timestamp offset beyond 65 s).
+size_t i2c_frame_encode(uint8_t *buf, size_t buf_size, uint8_t seq, const i2c_sample_t *samples, uint8_t count);
+
+// ---------------------------------------------------------------------------
+// Receive side
+// ---------------------------------------------------------------------------
+
+#define I2C_RX_RING_SIZE 512  // Power of two; matches the slave driver's RX buffer.
+
+typedef struct {
+    uint8_t buf[I2C_RX_RING_SIZE];
+    uint32_t head;  // Bytes written (free running).
+    uint32_t tail;  // Bytes consumed (free running).
+} i2c_rx_ring_t;
+
+typedef struct {
+    uint32_t frames;  // Valid frames delivered.
+    uint32_t samples;
+    uint32_t crc_errors;
+    uint32_t resync_bytes;  // Bytes skipped while hunting for a start of frame.
+    uint32_t seq_gaps;  // Frames missing according to the sequence numbers.
+    uint32_t duplicates;  // Frames repeated by a master retry.
+} i2c_rx_stats_t;
+
+typedef struct {
+    i2c_rx_ring_t ring;
+    bool have_seq;
+    uint8_t last_seq;
+    i2c_rx_stats_t stats;
+} i2c_rx_t;
+
+// A parsed frame still sitting in the ring.
+typedef struct {
+    uint32_t start;  // Ring position of the first SOF byte.
+    uint8_t seq;
+    uint8_t count;
+    uint32_t base_ms;
+} i2c_frame_view_t;
+
+void i2c_rx_init(i2c_rx_t *rx);
+
+// Contiguous free space at the write position, for reading straight into the ring.
+uint8_t *i2c_rx_write_ptr(i2c_rx_t *rx, size_t *space);
+void i2c_rx_commit(i2c_rx_t *rx, size_t len);
+
+// Find the next valid, non-duplicate frame. Returns false when more bytes are
+// needed. After handling the frame, call i2c_rx_consume() to release it.
+bool i2c_rx_next(i2c_rx_t *rx, i2c_frame_view_t *view);
+i2c_sample_t i2c_frame_sample(const i2c_rx_t *rx, const i2c_frame_view_t *view, uint8_t index);
+void i2c_rx_consume(i2c_rx_t *rx, const i2c_frame_view_t *view);
+
+// ---------------------------------------------------------------------------
+// Transmit side
+// ---------------------------------------------------------------------------
+
+// Physical link used by the transmitter. write() returns true when the slave
+// acknowledged the whole frame; recover() puts the bus back into a known state.
+typedef struct {
+    bool (*write)(void *ctx, const uint8_t *data, size_t len);
+    void (*recover)(void *ctx);
+    void (*delay_ms)(void *ctx, uint32_t ms);
+    int64_t (*now_us)(void *ctx);
+    void *ctx;
+} i2c_link_t;
+
+#define I2C_TX_MAX_ATTEMPTS 4  // Tries per frame; the bus is recovered before the last one.
+
+typedef struct {
+    uint32_t frames;  // Frames acknowledged.
+    uint32_t bytes;  // Bytes acknowledged.
+    uint32_t retries;  // Extra attempts after a failed write.
+    uint32_t recoveries;  // Bus recoveries performed.
+    uint32_t dropped;  // Frames given up after all attempts.
+    int64_t recovery_us_last;  // Time from the first failure to the next acknowledged frame.
+    int64_t recovery_us_max;
+} i2c_tx_stats_t;
+
+typedef struct {
+    i2c_link_t link;
+    uint8_t seq;
+    int64_t failing_since_us;  // -1 while the link is healthy.
+    uint8_t frame[I2C_FRAME_MAX_SIZE];
+    i2c_tx_stats_t stats;
+} i2c_tx_t;
+
+void i2c_tx_init(i2c_tx_t *tx, const i2c_link_t *link);
+
+// Send one batch as a frame, retrying with backoff and recovering the bus on
+// repeated failure. A retried frame keeps its sequence number so the receiver
+// can drop duplicates. Returns false if the frame was dropped.
+bool i2c_tx_send(i2c_tx_t *tx, const i2c_sample_t *samples, uint8_t count);
+
+// Loopback stand-in for the bus: frames go straight into a receiver's ring,
+// with optional fault injection, so throughput and recovery can be measured
+// on a host.
+typedef struct {
+    i2c_rx_t *rx;
+    uint32_t nack_every;  // Fail every Nth write (0 = never).
+    uint32_t corrupt_every;  // Flip a payload bit in every Nth accepted write (0 = never).
+    uint32_t writes;
+    int64_t clock_us;  // Simulated time, advanced by delays and by the bytes on the wire.
+    uint32_t bus_hz;  // Simulated bus speed used to advance the clock.
+} i2c_loopback_t;
+
+i2c_link_t i2c_loopback_link(i2c_loopback_t *loopback, i2c_rx_t *rx, uint32_t bus_hz);
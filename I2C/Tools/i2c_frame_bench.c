@@ -0,0 +1,183 @@
+// Host benchmark for the framed I2C transport over the loopback link.
+//
+// Build: gcc -O2 -I../Code -o i2c_frame_bench i2c_frame_bench.c ../Code/i2c_frame.c
+// Usage: ./i2c_frame_bench [samples per scenario, default 200000]
+//
+// Sends a stream of timestamped samples through i2c_tx_send into an i2c_rx_t
+// and parses every frame back, the way the master and slave tasks do. Each
+// scenario runs with one sample per frame and with full batches, on a clean
+// bus and with injected faults:
+//   - nack:    the loopback NACKs every 50th write; the retry goes through,
+//   - corrupt: a payload bit flips in every 40th frame; the CRC rejects it,
+//   - lost ack: every 60th frame arrives but its ACK is lost, so the retry
+//              arrives twice and the receiver must drop the duplicate,
+//   - stuck:   every 500th frame finds the bus stuck until the master resets
+//              it, which takes all I2C_TX_MAX_ATTEMPTS tries.
+// It reports bytes/s and frames/s on the simulated 100 kHz and 400 kHz bus
+// (the loopback clock counts nine clocks per byte plus backoff delays), host
+// time per frame, the receiver's error counters and the worst recovery time.
+// The program exits non-zero if a delivered sample is out of order or
+// altered, or if the receiver's frame and loss counts do not add up to the
+// frames sent.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include "i2c_frame.h"
+
+#define SAMPLE_PERIOD_MS 10
+
+static uint64_t now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000u + ts.tv_nsec;
+}
+
+// Wraps the loopback link with the faults the loopback itself cannot model.
+typedef struct {
+    i2c_link_t inner;
+    i2c_loopback_t *loopback;
+    uint32_t lost_ack_every;  // Deliver, then report a failure (0 = never).
+    uint32_t stuck_every;  // Bus stuck from this frame until recover() (0 = never).
+    uint32_t writes;
+    bool stuck;
+} fault_link_t;
+
+static bool fault_write(void *ctx, const uint8_t *data, size_t len) {
+    fault_link_t *fault = ctx;
+    fault->writes++;
+    if (fault->stuck_every && fault->writes % fault->stuck_every == 0) {
+        fault->stuck = true;
+    }
+    if (fault->stuck) {
+        fault->loopback->clock_us += 1000;  // Master times out on the held SDA line.
+        return false;
+    }
+    bool acked = fault->inner.write(fault->inner.ctx, data, len);
+    return acked && !(fault->lost_ack_every && fault->writes % fault->lost_ack_every == 0);
+}
+
+static void fault_recover(void *ctx) {
+    fault_link_t *fault = ctx;
+    fault->stuck = false;
+    fault->inner.recover(fault->inner.ctx);
+}
+
+static void fault_delay_ms(void *ctx, uint32_t ms) {
+    fault_link_t *fault = ctx;
+    fault->inner.delay_ms(fault->inner.ctx, ms);
+}
+
+static int64_t fault_now_us(void *ctx) {
+    fault_link_t *fault = ctx;
+    return fault->inner.now_us(fault->inner.ctx);
+}
+
+typedef struct {
+    const char *name;
+    uint32_t nack_every;
+    uint32_t corrupt_every;
+    uint32_t lost_ack_every;
+    uint32_t stuck_every;
+} scenario_t;
+
+static uint32_t run(const scenario_t *scenario, uint8_t batch, uint32_t bus_hz, uint32_t total_samples) {
+    static i2c_rx_t rx;
+    static i2c_loopback_t loopback;
+    i2c_rx_init(&rx);
+    fault_link_t fault = {
+        .inner = i2c_loopback_link(&loopback, &rx, bus_hz),
+        .loopback = &loopback,
+        .lost_ack_every = scenario->lost_ack_every,
+        .stuck_every = scenario->stuck_every,
+    };
+    loopback.nack_every = scenario->nack_every;
+    loopback.corrupt_every = scenario->corrupt_every;
+    i2c_link_t link = {
+        .write = fault_write,
+        .recover = fault_recover,
+        .delay_ms = fault_delay_ms,
+        .now_us = fault_now_us,
+        .ctx = &fault,
+    };
+    static i2c_tx_t tx;
+    i2c_tx_init(&tx, &link);
+
+    uint32_t sent_frames = 0;
+    uint32_t next_sample = 0;
+    uint32_t last_delivered = 0;
+    bool delivered_any = false;
+    uint32_t errors = 0;
+    i2c_sample_t samples[I2C_FRAME_MAX_SAMPLES];
+
+    uint64_t start = now_ns();
+    while (next_sample < total_samples) {
+        for (uint8_t i = 0; i < batch; i++) {
+            uint32_t n = next_sample + i;
+            samples[i] = (i2c_sample_t){ .timestamp_ms = n * SAMPLE_PERIOD_MS, .value = n & 0x0FFF };
+        }
+        next_sample += batch;
+        i2c_tx_send(&tx, samples, batch);
+        sent_frames++;
+
+        // Slave side: every delivered sample must match what was sent, in order.
+        i2c_frame_view_t view;
+        while (i2c_rx_next(&rx, &view)) {
+            for (uint8_t i = 0; i < view.count; i++) {
+                i2c_sample_t sample = i2c_frame_sample(&rx, &view, i);
+                uint32_t n = sample.timestamp_ms / SAMPLE_PERIOD_MS;
+                if (sample.timestamp_ms % SAMPLE_PERIOD_MS || sample.value != (n & 0x0FFF) ||
+                    (delivered_any && n <= last_delivered)) {
+                    errors++;
+                }
+                last_delivered = n;
+                delivered_any = true;
+            }
+            i2c_rx_consume(&rx, &view);
+        }
+    }
+    uint64_t elapsed = now_ns() - start;
+
+    // Every frame sent is either delivered or counted as lost. Frames lost
+    // after the last delivered one show no gap yet, so count them from the
+    // sequence numbers.
+    uint32_t trailing = (uint8_t)(tx.seq - 1 - rx.last_seq);
+    if (rx.stats.frames + rx.stats.seq_gaps + trailing != sent_frames) {
+        errors++;
+    }
+    double bus_s = loopback.clock_us / 1e6;
+    printf("%-8s %3u kHz %2u/frame | %8.0f B/s %7.1f frames/s %8.0f samples/s | %6.0f ns/frame | "
+           "%5lu lost %4lu crc %4lu dup %5lu resync | %4lu retries %3lu resets, recovery max %6lld us%s\n",
+           scenario->name, (unsigned)(bus_hz / 1000), batch, tx.stats.bytes / bus_s, rx.stats.frames / bus_s,
+           rx.stats.samples / bus_s, (double)elapsed / sent_frames, (unsigned long)rx.stats.seq_gaps,
+           (unsigned long)rx.stats.crc_errors, (unsigned long)rx.stats.duplicates,
+           (unsigned long)rx.stats.resync_bytes, (unsigned long)tx.stats.retries,
+           (unsigned long)tx.stats.recoveries, (long long)tx.stats.recovery_us_max, errors ? "  <-- FAIL" : "");
+    return errors;
+}
+
+int main(int argc, char **argv) {
+    uint32_t total_samples = argc > 1 ? (uint32_t)strtoul(argv[1], NULL, 0) : 200000;
+    static const scenario_t scenarios[] = {
+        { .name = "clean" },
+        { .name = "nack", .nack_every = 50 },
+        { .name = "corrupt", .corrupt_every = 40 },
+        { .name = "lost ack", .lost_ack_every = 60 },
+        { .name = "stuck", .stuck_every = 500 },
+    };
+    static const uint32_t bus_speeds[] = { 100000, 400000 };
+    static const uint8_t batches[] = { 1, I2C_FRAME_MAX_SAMPLES };
+    uint32_t errors = 0;
+
+    for (size_t s = 0; s < sizeof(scenarios) / sizeof(scenarios[0]); s++) {
+        for (size_t b = 0; b < sizeof(bus_speeds) / sizeof(bus_speeds[0]); b++) {
+            for (size_t n = 0; n < sizeof(batches); n++) {
+                errors += run(&scenarios[s], batches[n], bus_speeds[b], total_samples);
+            }
+        }
+    }
+    if (errors) {
+        printf("%u scenarios delivered wrong data or lost count\n", errors);
+    }
+    return errors ? 1 : 0;
+}
@@ -1,84 +1,400 @@
 #include <stdio.h>
+#include <string.h>
+#include <sys/time.h>
 #include "freertos/FreeRTOS.h"
 #include "freertos/task.h"
 #include "esp_sleep.h"
 #include "esp_log.h"
 #include "driver/gpio.h"
+#include "driver/adc.h"
+#include "esp_adc_cal.h"
 #include "esp_timer.h"
 #include "driver/rtc_io.h"
+#include "driver/i2c.h"
+#include "esp_rom_sys.h"
+#include "power_manager.h"
+#include "rtc_snapshot.h"
+#include "sample_log.h"
+#include "trace_ring.h" // Sleep, wake and button events as binary records, printed in bulk
+#include "i2c_frame.h" // From I2C/Code, so a flush lands on the I2C example's slave
 
 #define BLUE_PIN GPIO_NUM_25
 #define RED_PIN GPIO_NUM_32
 #define BUTTON_PIN GPIO_NUM_26
+#define LIGHT_SENSOR_CHANNEL ADC1_CHANNEL_6 // GPIO34
+#define I2C_MASTER_SCL_IO 22
+#define I2C_MASTER_SDA_IO 21
+#define I2C_SLAVE_ADDR 0X28
+#define I2C_MASTER_FREQ_HZ 100000
+#define I2C_TIMEOUT_MS 50
 
 #define LED_ON_TIME_MS 400
 #define LED_OFF_TIME_MS 1600
-#define LIGHT_SLEEP_THRESHOLD_US 3000000 // 3 seconds in microseconds
-#define DEEP_SLEEP_THRESHOLD_US 30000000 // 30 seconds in microseconds
+#define ACTIVITY_WINDOW_US 30000000 // Keep blinking for 30 seconds after the last wake event
+#define BUTTON_MAX_LATENCY_US 300000 // A press must be handled within 300 ms
+#define LIGHT_SENSOR_MARGIN_MV 300 // Rise above the ambient baseline that counts as activity
+#define LIGHT_SENSOR_BASELINE_SAMPLES 64 // Readings averaged for the baseline on a cold start
+#define LIGHT_SENSOR_POLL_US 10000000 // No sleep state wakes on the ADC, so it is polled every 10 s
+#define STATS_INTERVAL_US 10000000
+#define LOG_INTERVAL_MS 10000 // One short sampling wake every 10 s
+#define LOG_BURST_SAMPLES 14 // Two bursts fill one I2C frame
+#define LOG_BURST_SPACING_MS 2
+#define LOG_WATERMARK (SAMPLE_LOG_CAPACITY * 3 / 4) // Bring the bus up only once the log is this full
+#define SNAPSHOT_VERSION 2 // Bump whenever sleep_snapshot_t changes
 
 const char* TAG = "MAIN";
 
-RTC_DATA_ATTR static bool chooseLED = false;
-RTC_DATA_ATTR static int64_t lastButtonPressTime = 0;
+// Everything the next boot needs to skip initialisation, sealed before each deep sleep.
+typedef struct {
+    gpio_config_t ledConfig; // Peripheral configuration
+    gpio_config_t buttonConfig;
+    adc_bits_width_t adcWidth;
+    adc_atten_t adcAtten;
+    esp_adc_cal_characteristics_t sensorCal; // Calibration; its curve pointers are safe because the build id matches
+    uint32_t thresholdMv;
+    bool chooseLED; // Application state
+    bool lightAboveThreshold;
+    uint32_t nextLogMs; // Wall-clock time of the next sampling wake
+    uint8_t i2cSeq; // Frame sequence number, kept so the slave does not take a new frame for a retry
+} sleep_snapshot_t;
+
+// Cost of the burst flushes, to compare with sending every sample as it is taken.
+typedef struct {
+    uint32_t flushes;
+    uint32_t records; // Sampling wakes flushed
+    uint32_t samples;
+    uint32_t wireBytes;
+    int64_t busOnUs; // From starting the I2C driver to deleting it
+    int64_t bringUpUs; // Driver start-up alone
+} flush_stats_t;
+
+RTC_DATA_ATTR static rtc_snapshot_t snapshot;
+RTC_DATA_ATTR static sleep_snapshot_t saved;
+RTC_DATA_ATTR static rtc_resume_stats_t resumeStats;
+RTC_DATA_ATTR static sample_log_t sampleLog;
+RTC_DATA_ATTR static flush_stats_t flushStats;
+
+static pm_t pm;
+static pm_esp_t pm_esp;
+static int blink_client;
+static int log_client;
+static i2c_tx_t logTx;
+
+// System time keeps running through deep sleep, unlike esp_timer
+static uint32_t wall_ms(void) {
+    struct timeval tv;
+    gettimeofday(&tv, NULL);
+    return (uint32_t)(tv.tv_sec * 1000LL + tv.tv_usec / 1000);
+}
 
 void lampColours(bool chooseLED) {
     gpio_set_level(BLUE_PIN, chooseLED ? 0 : 1);
     gpio_set_level(RED_PIN, chooseLED ? 1 : 0);
 }
 
-void button_interrupt_handler(void* arg) {
-    uint32_t gpio_num = (uint32_t)arg;
-    if (gpio_num == BUTTON_PIN) {
-        chooseLED = !chooseLED;
-        lampColours(chooseLED);
-        lastButtonPressTime = esp_timer_get_time(); // Update time on button press
-        ESP_LOGI(TAG, "Button pressed: Switching LED to %s", chooseLED ? "Red" : "Blue");
+static void leds_off(void) {
+    gpio_set_level(BLUE_PIN, 0);
+    gpio_set_level(RED_PIN, 0);
+}
+
+static void handle_button(void) {
+    saved.chooseLED = !saved.chooseLED;
+    lampColours(saved.chooseLED);
+    trace_emit(TRACE_SLEEP_BUTTON, saved.chooseLED, 0); // 1 = red, 0 = blue
+    while (gpio_get_level(BUTTON_PIN) == 0) {
+        vTaskDelay(pdMS_TO_TICKS(20)); // Wait for release, or the held level wakes the next sleep at once
+    }
+}
+
+// Returns true when the reading has just crossed the threshold upwards.
+static bool poll_light_sensor(void) {
+    uint32_t mv = esp_adc_cal_raw_to_voltage(adc1_get_raw(LIGHT_SENSOR_CHANNEL), &saved.sensorCal);
+    bool above = mv > saved.thresholdMv;
+    bool crossed = above && !saved.lightAboveThreshold;
+    saved.lightAboveThreshold = above;
+    return crossed;
+}
+
+// The GPIO matrix and the ADC controller are powered down in deep sleep, so this runs on every boot.
+// It is a handful of register writes; what the warm path saves is the eFuse characterisation and
+// the baseline in cold_start().
+static void apply_peripherals(void) {
+    rtc_gpio_deinit(BUTTON_PIN); // ext0 leaves the pad routed to the RTC domain after a deep sleep
+    gpio_config(&saved.ledConfig);
+    gpio_config(&saved.buttonConfig);
+    adc1_config_width(saved.adcWidth);
+    adc1_config_channel_atten(LIGHT_SENSOR_CHANNEL, saved.adcAtten);
+}
+
+// Power-on, or a snapshot that cannot be trusted: build everything from scratch.
+// Returns the time spent on the ambient baseline, which only this path pays.
+static int64_t cold_start(void) {
+    memset(&saved, 0, sizeof(saved));
+    saved.ledConfig = (gpio_config_t) {
+        .pin_bit_mask = (1ULL << BLUE_PIN) | (1ULL << RED_PIN),
+        .mode = GPIO_MODE_OUTPUT,
+    };
+    saved.buttonConfig = (gpio_config_t) {
+        .pin_bit_mask = 1ULL << BUTTON_PIN,
+        .mode = GPIO_MODE_INPUT,
+        .pull_up_en = GPIO_PULLUP_ENABLE,
+    };
+    saved.adcWidth = ADC_WIDTH_BIT_12;
+    saved.adcAtten = ADC_ATTEN_DB_11;
+    apply_peripherals();
+
+    esp_adc_cal_characterize(ADC_UNIT_1, saved.adcAtten, saved.adcWidth, 1100, &saved.sensorCal); // eFuse read
+    int64_t baselineStart = esp_timer_get_time();
+    uint32_t sum = 0;
+    for (int i = 0; i < LIGHT_SENSOR_BASELINE_SAMPLES; i++) {
+        sum += esp_adc_cal_raw_to_voltage(adc1_get_raw(LIGHT_SENSOR_CHANNEL), &saved.sensorCal);
+        vTaskDelay(1); // Spread the baseline over a few ticks of ambient light
+    }
+    saved.thresholdMv = sum / LIGHT_SENSOR_BASELINE_SAMPLES + LIGHT_SENSOR_MARGIN_MV;
+    saved.lightAboveThreshold = false;
+    saved.nextLogMs = wall_ms();
+    return esp_timer_get_time() - baselineStart;
+}
+
+// One sampling wake: a short burst of readings appended to the RTC log as one record.
+static void log_burst(uint32_t nowMs) {
+    uint16_t samples[LOG_BURST_SAMPLES];
+    for (int i = 0; i < LOG_BURST_SAMPLES; i++) {
+        samples[i] = adc1_get_raw(LIGHT_SENSOR_CHANNEL);
+        if (i + 1 < LOG_BURST_SAMPLES) {
+            esp_rom_delay_us(LOG_BURST_SPACING_MS * 1000);
+        }
+    }
+    sample_log_append(&sampleLog, nowMs, LOG_BURST_SPACING_MS, samples, LOG_BURST_SAMPLES);
+}
+
+static esp_err_t i2c_bus_up(void) {
+    i2c_config_t i2c_config = {
+        .mode = I2C_MODE_MASTER,
+        .sda_io_num = I2C_MASTER_SDA_IO,
+        .sda_pullup_en = GPIO_PULLUP_ENABLE,
+        .scl_io_num = I2C_MASTER_SCL_IO,
+        .scl_pullup_en = GPIO_PULLUP_ENABLE,
+        .master.clk_speed = I2C_MASTER_FREQ_HZ
+    };
+    esp_err_t err = i2c_param_config(I2C_NUM_0, &i2c_config);
+    if (err != ESP_OK) {
+        return err;
+    }
+    return i2c_driver_install(I2C_NUM_0, i2c_config.mode, 0, 0, 0);
+}
+
+static bool i2c_link_write(void *ctx, const uint8_t *data, size_t len) {
+    return i2c_master_write_to_device(I2C_NUM_0, I2C_SLAVE_ADDR, data, len, pdMS_TO_TICKS(I2C_TIMEOUT_MS)) == ESP_OK;
+}
+
+static void i2c_link_recover(void *ctx) {
+    i2c_driver_delete(I2C_NUM_0);
+    i2c_bus_up();
+}
+
+static void i2c_link_delay_ms(void *ctx, uint32_t ms) {
+    vTaskDelay(pdMS_TO_TICKS(ms) ? pdMS_TO_TICKS(ms) : 1);
+}
+
+static int64_t i2c_link_now_us(void *ctx) {
+    return esp_timer_get_time();
+}
+
+// Bring the bus up once and send the whole log as full frames. Whole records go into a frame,
+// so the records of a frame that is dropped stay in the log for the next flush.
+static void flush_log(void) {
+    int64_t start = esp_timer_get_time();
+    if (i2c_bus_up() != ESP_OK) {
+        ESP_LOGW(TAG, "I2C bus did not come up, keeping %u logged bytes", sample_log_used(&sampleLog));
+        return;
+    }
+    int64_t up = esp_timer_get_time();
+    i2c_link_t link = {
+        .write = i2c_link_write,
+        .recover = i2c_link_recover,
+        .delay_ms = i2c_link_delay_ms,
+        .now_us = i2c_link_now_us,
+    };
+    i2c_tx_init(&logTx, &link);
+    logTx.seq = saved.i2cSeq;
+
+    uint8_t record[SAMPLE_LOG_MAX_RECORD];
+    uint16_t values[I2C_FRAME_MAX_SAMPLES];
+    i2c_sample_t batch[I2C_FRAME_MAX_SAMPLES];
+    uint8_t batchLen = 0;
+    uint8_t batchRecords = 0;
+    uint32_t cursor = sample_log_begin(&sampleLog);
+    while (true) {
+        uint32_t next = cursor;
+        uint32_t timeMs = 0;
+        uint16_t intervalMs = 0;
+        size_t len = sample_log_read(&sampleLog, &next, record, sizeof(record));
+        size_t count = len ? sample_log_decode(record, len, &timeMs, &intervalMs, values, I2C_FRAME_MAX_SAMPLES) : 0;
+        uint32_t lastMs = timeMs + (count - 1) * intervalMs;
+        bool fits = count > 0 && batchLen + count <= I2C_FRAME_MAX_SAMPLES &&
+                    (batchLen == 0 || lastMs - batch[0].timestamp_ms <= UINT16_MAX); // Frame offsets are 16-bit ms
+        if (batchLen > 0 && !fits) {
+            if (!i2c_tx_send(&logTx, batch, batchLen)) {
+                ESP_LOGW(TAG, "Frame dropped, keeping the rest of the log");
+                break;
+            }
+            sample_log_release(&sampleLog, cursor);
+            flushStats.records += batchRecords;
+            flushStats.samples += batchLen;
+            batchLen = 0;
+            batchRecords = 0;
+            continue; // Retry this record in an empty frame
+        }
+        if (len == 0) {
+            break;
+        }
+        for (size_t i = 0; i < count; i++) {
+            batch[batchLen].timestamp_ms = timeMs + i * intervalMs;
+            batch[batchLen++].value = values[i];
+        }
+        batchRecords++;
+        cursor = next; // A malformed record decodes to nothing and is skipped here
+    }
+
+    i2c_driver_delete(I2C_NUM_0);
+    saved.i2cSeq = logTx.seq;
+    flushStats.flushes++;
+    flushStats.wireBytes += logTx.stats.bytes;
+    flushStats.busOnUs += esp_timer_get_time() - start;
+    flushStats.bringUpUs += up - start;
+}
+
+static void log_flush_stats(void) {
+    const flush_stats_t *f = &flushStats;
+    if (f->samples == 0) {
+        return;
     }
+    // Sending each sample on its own would mean a bus bring-up per wake and a one-sample frame per sample
+    uint32_t frameBytes = I2C_FRAME_HEADER_SIZE + I2C_FRAME_SAMPLE_SIZE + I2C_FRAME_CRC_SIZE;
+    int64_t perSampleOnUs = f->records * (f->bringUpUs / f->flushes) +
+                            (int64_t)f->samples * (frameBytes + 1) * 9 * 1000000 / I2C_MASTER_FREQ_HZ;
+    ESP_LOGI(TAG, "Log: %lu flushes, %lu samples, RTC %lu.%02lu B/sample, wire %lu.%02lu B/sample (one-sample frames: %lu)",
+             f->flushes, f->samples, sampleLog.stats.bytes / sampleLog.stats.samples,
+             sampleLog.stats.bytes * 100 / sampleLog.stats.samples % 100,
+             f->wireBytes / f->samples, f->wireBytes * 100 / f->samples % 100, frameBytes);
+    ESP_LOGI(TAG, "Log: bus on %lld ms in bursts vs ~%lld ms sending per sample, %lu records dropped",
+             f->busOnUs / 1000, perSampleOnUs / 1000, sampleLog.stats.dropped_records);
 }
 
 void app_main(void) {
-    gpio_set_direction(BLUE_PIN, GPIO_MODE_OUTPUT);
-    gpio_set_direction(RED_PIN, GPIO_MODE_OUTPUT);
+    trace_emit_boot(); // Every wake from deep sleep is a boot; this record lets the decoder tell them apart
+    // The LED and sensor setup only changes with the firmware, so a valid snapshot skips rebuilding it.
+    uint32_t buildId = rtc_snapshot_build_id();
+    rtc_snapshot_status_t status = rtc_snapshot_check(&snapshot, &saved, sizeof(saved), SNAPSHOT_VERSION, buildId);
+    bool warm = status == RTC_SNAPSHOT_OK;
+    if (!sample_log_valid(&sampleLog)) {
+        sample_log_init(&sampleLog); // The log has its own check, so a cold start keeps unsent samples
+        memset(&flushStats, 0, sizeof(flushStats));
+    }
+    int64_t setupUs = 0;
+    if (warm) {
+        apply_peripherals();
+    } else {
+        setupUs = cold_start();
+    }
 
-    esp_sleep_enable_ext0_wakeup(BUTTON_PIN, 0); // Wake up on low level from BUTTON_PIN
+    pm_backend_t backend = pm_esp_backend(&pm_esp, BUTTON_PIN, 0); // Wake on low level from BUTTON_PIN
+    pm_init(&pm, &backend, NULL);
+    blink_client = pm_register(&pm, "blink", 0, 0, PM_STATE_LIGHT_SLEEP); // LEDs go dark in deep sleep
+    pm_register(&pm, "button", PM_WAKE_EXT0, BUTTON_MAX_LATENCY_US, PM_STATE_DEEP_SLEEP);
+    pm_register(&pm, "light", PM_WAKE_ADC_THRESHOLD, LIGHT_SENSOR_POLL_US, PM_STATE_DEEP_SLEEP);
+    log_client = pm_register(&pm, "log", 0, 0, PM_STATE_DEEP_SLEEP);
 
-    gpio_pad_select_gpio(BUTTON_PIN);
-    gpio_set_direction(BUTTON_PIN, GPIO_MODE_INPUT);
-    gpio_set_pull_mode(BUTTON_PIN, GPIO_PULLUP_ONLY);
-    gpio_set_intr_type(BUTTON_PIN, GPIO_INTR_POSEDGE);
-    gpio_install_isr_service(ESP_INTR_FLAG_LEVEL1);
-    gpio_isr_handler_add(BUTTON_PIN, button_interrupt_handler, (void*) BUTTON_PIN);
+    // Every deep sleep wake starts here, so decide whether this boot has anything to show.
+    int64_t now = esp_timer_get_time();
+    int64_t activeUntil = now + ACTIVITY_WINDOW_US;
+    rtc_resume_record(&resumeStats, warm, now, setupUs); // Ready for the first useful work, since esp_timer start
+    ESP_LOGI(TAG, "%s start (snapshot %s), threshold %lu mV", warm ? "Warm" : "Cold",
+             rtc_snapshot_status_name(status), saved.thresholdMv);
+    switch (esp_sleep_get_wakeup_cause()) {
+    case ESP_SLEEP_WAKEUP_EXT0:
+        handle_button();
+        break;
+    case ESP_SLEEP_WAKEUP_TIMER:
+        if (!poll_light_sensor()) {
+            activeUntil = now; // Routine poll with nothing new: straight back to deep sleep
+        }
+        break;
+    default:
+        poll_light_sensor();
+        break;
+    }
 
-    lastButtonPressTime = esp_timer_get_time();
+    bool ledOn = false;
+    int64_t nextToggle = now;
+    int64_t nextStats = now + STATS_INTERVAL_US;
 
     while (true) {
-        int64_t currentTime = esp_timer_get_time();
-        
-        lampColours(chooseLED); // Control LEDs based on current state
-        vTaskDelay(pdMS_TO_TICKS(LED_ON_TIME_MS));
-        gpio_set_level(BLUE_PIN, 0);
-        gpio_set_level(RED_PIN, 0);
-        vTaskDelay(pdMS_TO_TICKS(LED_OFF_TIME_MS));
-
-        currentTime = esp_timer_get_time(); // Update the current time before checking sleep conditions
-
-        // Enter light sleep if no button press for over 3 seconds
-        if (currentTime - lastButtonPressTime > LIGHT_SLEEP_THRESHOLD_US) {
-            ESP_LOGI(TAG, "Entering light sleep due to inactivity");
-            esp_sleep_enable_timer_wakeup(5000 * 1000); // Wake up after 5 seconds if no other wake-up triggers
-            esp_light_sleep_start();
-            ESP_LOGI(TAG, "Woke up from light sleep");
-            lastButtonPressTime = esp_timer_get_time(); // Refresh the timer as waking up resets the MCU
+        now = esp_timer_get_time();
+
+        uint32_t nowMs = wall_ms();
+        if ((int32_t)(nowMs - saved.nextLogMs) >= 0) {
+            log_burst(nowMs);
+            saved.nextLogMs = nowMs + LOG_INTERVAL_MS;
+            if (sample_log_used(&sampleLog) >= LOG_WATERMARK) {
+                flush_log();
+                log_flush_stats();
+            }
+        }
+        pm_set_deadline(&pm, log_client, now + (int64_t)(int32_t)(saved.nextLogMs - nowMs) * 1000);
+
+        if (now < activeUntil) {
+            if (now >= nextToggle) {
+                ledOn = !ledOn;
+                if (ledOn) {
+                    lampColours(saved.chooseLED);
+                } else {
+                    leds_off();
+                }
+                nextToggle = now + (ledOn ? LED_ON_TIME_MS : LED_OFF_TIME_MS) * 1000LL;
+            }
+            pm_set_deadline(&pm, blink_client, nextToggle);
+        } else {
+            leds_off(); // Blinking is done, so the blink client no longer holds the chip out of deep sleep
+            ledOn = false;
+            pm_set_deadline(&pm, blink_client, PM_NO_DEADLINE);
         }
 
-        // Enter deep sleep if no button press for over 30 seconds
-        if (currentTime - lastButtonPressTime > DEEP_SLEEP_THRESHOLD_US) {
-            ESP_LOGI(TAG, "No activity for 30 seconds, entering deep sleep");
-            gpio_set_level(BLUE_PIN, 0);
-            gpio_set_level(RED_PIN, 0); // Ensure LEDs are turned off before deep sleep
-            esp_deep_sleep_start();
+        pm_decision_t decision = pm_decide(&pm, now);
+        bool deepSleep = decision.state == PM_STATE_DEEP_SLEEP;
+        trace_emit(TRACE_SLEEP_ENTER, decision.state, (uint32_t)decision.limiting_client);
+        if (now >= nextStats || deepSleep) {
+            pm_log_stats(&pm, TAG); // Deep sleep never returns, so report before it
+            rtc_resume_log_stats(&resumeStats, TAG);
+            trace_flush(); // No drain task here: light sleep would stop it anyway, and deep sleep loses the rings
+            nextStats = now + STATS_INTERVAL_US;
+        }
+        if (deepSleep) {
+            rtc_snapshot_seal(&snapshot, &saved, sizeof(saved), SNAPSHOT_VERSION, buildId);
+        }
+
+        pm_wake_t wake = pm_sleep(&pm);
+        trace_emit(TRACE_SLEEP_WAKE, wake.cause, decision.state);
+
+        if (wake.cause == PM_WAKE_EXT0) {
+            handle_button();
+            activeUntil = esp_timer_get_time() + ACTIVITY_WINDOW_US;
+        }
+        if (poll_light_sensor()) {
+            pm_record_latency(&pm, now); // Upper bound: it crossed at some point during the last stay
+            ESP_LOGI(TAG, "Light sensor above threshold");
+            activeUntil = esp_timer_get_time() + ACTIVITY_WINDOW_US;
         }
     }
 }
 
-
+// Essential Tips:
+// 1. Each part of the application publishes its next deadline; the power manager picks light or deep sleep to fit.
+// 2. Light sleep keeps RAM and GPIO levels, so the blink continues across it at a fraction of the active current.
+// 3. Deep sleep costs about 200 ms to wake (a full boot), so it only pays off for long idle stretches.
+// 4. The ESP32 cannot wake on an ADC threshold without the ULP, so the sensor is polled within its latency budget.
+// 5. Anything that must survive deep sleep lives in RTC memory (RTC_DATA_ATTR).
+// 6. Seal the snapshot last, right before sleeping; any later write breaks its CRC and forces a cold start.
+// 7. Log samples into RTC memory on short wakes and pay for the bus (or radio) only once per full log.
+// 8. Every line printed keeps the chip awake while the UART drains; emit trace records and print them in one go.
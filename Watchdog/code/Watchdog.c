@@ -4,39 +4,93 @@
 #include "esp_log.h"
 #include "esp_task_wdt.h"
 #include "driver/gpio.h"
+#include "esp_timer.h"
+#include "esp_attr.h"
+#include "esp_system.h"
+#include "esp_rom_sys.h"
+#include "isr_queue.h" // Lock-free handoff from the button ISR to the main task
+#include "task_supervisor.h" // Heartbeats from every task decide whether the WDT is fed
+#include "trace_ring.h" // Binary trace records instead of formatted logs in the loop and the ISR
 
 #define INTERRUPT_PIN GPIO_NUM_33 // GPIO 33 for the button
 #define LED_PIN GPIO_NUM_32       // GPIO 32 for the LED
 
+#define SAMPLER_PERIOD_MS 10 // Loop period of the simulated sampling task
+#define SAMPLER_CORE 1
+#define SUPERVISOR_PERIOD_MS 20 // How often the supervisor checks the heartbeats
+#define WDT_TIMEOUT_MS 500 // Feeding stops on a confirmed miss, so this is the delay from the miss to the reset
+#define STALL_DEMO 0 // Set to 1 to make the fifth button press hang the sampling task
+#define STALL_DEMO_PRESSES 5
+#define TRACE_DRAIN_PERIOD_MS 500 // How often the trace task prints the rings
+
 static uint32_t i = 0; // Initialize a counter variable
 
-volatile bool buttonPressed = false; // Declare a volatile flag variable to track button press
+static isr_queue_t button_events; // Button presses queued by the ISR for the main task
+static TaskHandle_t main_task; // Task woken by the ISR
+static TaskHandle_t sampler_task; // Notified by the main task to simulate a hang
+
+// Supervisor state; the record survives the reset that follows a stall
+static supervisor_t supervisor;
+RTC_NOINIT_ATTR static supervisor_record_t supervisor_record;
+RTC_NOINIT_ATTR static rtc_snapshot_t supervisor_header;
+static supervisor_slot_t *main_heartbeat;
+static supervisor_slot_t *sampler_heartbeat;
 
 // Interrupt handler for GPIO button press
 void IRAM_ATTR gpio_interrupt_handler(void *arg) {
-    int currentLevel = gpio_get_level(LED_PIN); // Get the current level of the LED pin
-    gpio_set_level(LED_PIN, !currentLevel); // Toggle LED state
-    i += 10; // Simulate an action by incrementing the counter
-    buttonPressed = true; // Set the button press flag
-    
-    // Optionally, signal the main loop to reset the WDT or perform direct WDT reset if applicable
+    // Only record the press; the LED, the counter and the WDT reset are handled by the main task
+    trace_emit(TRACE_WDT_PRESS, (uint32_t)(uintptr_t)arg, 0); // Safe here, unlike ESP_LOGI
+    isr_queue_push_and_notify(&button_events, main_task, (uint32_t)(uintptr_t)arg);
+}
+
+// Stand-in for a real-time sampling loop: a little work every 10 ms, with a heartbeat per iteration
+static void sampler(void *arg) {
+    uint32_t acc = 0;
+    TickType_t last_wake = xTaskGetTickCount();
+    for (;;) {
+        for (int n = 0; n < 1000; n++) {
+            acc = acc * 1664525 + 1013904223; // Simulated processing
+        }
+        supervisor_heartbeat(sampler_heartbeat);
+#if STALL_DEMO
+        if (ulTaskNotifyTake(pdTRUE, 0)) {
+            vTaskSuspend(NULL); // Simulated deadlock: the heartbeat stops
+        }
+#endif
+        vTaskDelayUntil(&last_wake, pdMS_TO_TICKS(SAMPLER_PERIOD_MS));
+    }
 }
 
 void app_main(void) {
+    trace_emit_boot(); // Marks the reset for trace_decode, whatever the timestamps do
+
     // Configure WDT
     esp_task_wdt_config_t wdtConfig = {
-        .timeout_ms = 10000, // Timeout after 10 seconds
-        .trigger_panic = false, // Do not trigger panic on WDT timeout
-        .idle_core_mask = NULL // Use all cores for WDT
+        .timeout_ms = WDT_TIMEOUT_MS, // Only needs to cover a few supervisor periods
+        .trigger_panic = true, // Reset when the supervisor stops feeding
+        .idle_core_mask = 0 // Only the supervisor task is watched directly
     };
     ESP_ERROR_CHECK(esp_task_wdt_reconfigure(&wdtConfig)); // Reconfigure the WDT with the specified parameters
-    ESP_ERROR_CHECK(esp_task_wdt_add(NULL)); // Add the current task to the WDT watchlist
+    main_task = xTaskGetCurrentTaskHandle(); // The ISR wakes this task
+
+    // Tasks register a heartbeat with a deadline class; only the supervisor task feeds the WDT
+    supervisor_init(&supervisor, &supervisor_record, &supervisor_header, rtc_snapshot_build_id(),
+                    esp_rom_get_cpu_ticks_per_us(), esp_reset_reason() == ESP_RST_TASK_WDT);
+    supervisor_log_record(&supervisor, "main"); // Worst-case loop times and misses from before the reset
+    supervisor_benchmark("main");
+    int64_t now = esp_timer_get_time();
+    main_heartbeat = supervisor_register(&supervisor, "main", SUPERVISOR_CLASS_SLOW, now);
+    sampler_heartbeat = supervisor_register(&supervisor, "sampler", SUPERVISOR_CLASS_FAST, now);
+    xTaskCreatePinnedToCore(sampler, "sampler", 2048, NULL, 5, &sampler_task, SAMPLER_CORE);
+    supervisor_start(&supervisor, SUPERVISOR_PERIOD_MS, 10);
+    isr_queue_init(&button_events); // Start with an empty event queue
+    trace_start_drain_task(TRACE_DRAIN_PERIOD_MS, 1); // Prints "#T" lines for Common/Tools/trace_decode
 
     // Configure GPIO (button and LED as before)
     gpio_config_t io_config = {
         .pin_bit_mask = (1ULL << INTERRUPT_PIN), // Set the pin bitmask for the interrupt pin
         .mode = GPIO_MODE_INPUT, // Configure as input mode
-        .intr_type = GPIO_INTR_HIGH_LEVEL // Interrupt type for rising edge
+        .intr_type = GPIO_INTR_POSEDGE // Interrupt type for rising edge, one event per press
     };
     gpio_config(&io_config); // Configure GPIO with the specified parameters
     gpio_install_isr_service(0); // Install the GPIO ISR service
@@ -46,12 +100,45 @@ void app_main(void) {
     gpio_set_level(LED_PIN, 0); // Assume 0 turns off the LED initially
 
     // Main loop
+    bool led_on = false; // Track the LED state here; reading back an output pin is not reliable
+#if STALL_DEMO
+    uint32_t presses = 0;
+#endif
+    uint32_t seconds = 0;
+    TickType_t last_log = xTaskGetTickCount();
+    const TickType_t log_period = pdMS_TO_TICKS(1000);
     for (;;) {
-        vTaskDelay(1000 / portTICK_PERIOD_MS); // Wait for 1 second
-        ESP_LOGI("main", "i = %lu", i++); // Log the value of 'i'
-        if (buttonPressed) {
-            esp_task_wdt_reset(); // Reset the WDT to prevent timeout
-            buttonPressed = false; // Reset the button press flag
+        // Sleep until a button press or the next once-per-second log, whichever comes first
+        TickType_t elapsed = xTaskGetTickCount() - last_log;
+        ulTaskNotifyTake(pdTRUE, elapsed < log_period ? log_period - elapsed : 0);
+        supervisor_heartbeat(main_heartbeat); // At least once a second, well inside the SLOW budget
+        isr_queue_wakeup(&button_events);
+
+        // Handle every press queued since the last wake-up
+        bool pressed = false;
+        isr_event_t event;
+        while (isr_queue_pop(&button_events, &event, esp_timer_get_time())) {
+            led_on = !led_on;
+            gpio_set_level(LED_PIN, led_on); // Toggle LED state
+            i += 10; // Simulate an action by incrementing the counter
+            trace_emit(TRACE_WDT_BUTTON, i, (uint32_t)(esp_timer_get_time() - event.timestamp_us));
+            pressed = true;
+#if STALL_DEMO
+            if (++presses == STALL_DEMO_PRESSES) {
+                xTaskNotifyGive(sampler_task); // Hang the sampler; expect a miss within 50 ms and a WDT reset 0.5 s later
+            }
+#endif
+        }
+        if (pressed) {
+            isr_queue_log_stats(&button_events, "main"); // Report overflows and ISR-to-task latency
+        }
+
+        if (xTaskGetTickCount() - last_log >= log_period) {
+            last_log += log_period;
+            trace_emit(TRACE_WDT_TICK, i++, 0); // Record 'i' without formatting it
+            if (++seconds % 10 == 0) {
+                supervisor_log_record(&supervisor, "main");
+            }
         }
     }
 }
@@ -63,10 +150,10 @@ void app_main(void) {
 // 2. Task Reconfiguration: Reconfigure the watchdog timer if task execution times change significantly to prevent premature resets or timeouts.
 // 3. Error Handling: Implement error handling mechanisms to detect and recover from unexpected errors or faults that may trigger the watchdog timer.
 // 4. Task Prioritization: Prioritize critical tasks to ensure they complete within the watchdog timeout period, minimizing the risk of system resets.
-// 5. Reset Frequency: Reset the watchdog timer at regular intervals to prevent it from reaching its timeout and triggering a system reset.
+// 5. Reset Frequency: Feed the watchdog from one supervisor that checks every task's heartbeat, not from whichever task happens to run.
 // 6. Testing: Thoroughly test the watchdog functionality under various conditions to validate its effectiveness in preventing system crashes.
 // 7. System Health Monitoring: Monitor system health indicators and log watchdog resets to identify potential issues and improve system reliability.
-// 8. Interrupt Handling: Implement interrupt handlers to respond promptly to critical events and reset the watchdog timer as needed.
+// 8. Interrupt Handling: Keep interrupt handlers short; queue the event and let a task act on it, and never call ESP_LOGI from one (emit a trace record instead).
 // 9. Documentation: Document the watchdog configuration settings and reset logic for future reference and troubleshooting.
 // 10. System Recovery: Implement recovery mechanisms to gracefully handle watchdog timeouts and restore the system to a stable state.
 